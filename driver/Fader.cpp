@@ -1,9 +1,7 @@
 #include "Fader.h"
 
-// FIXME: brightness shift needs attention, probably
-
-
-#define FADESTEPTIME 0
+#define DEFAULT_FADETIME 5    // mS per step
+#define DEFAULT_FADESTEPS 255 // ... so a full fade takes about 1.3 seconds
 #define NUMPIXELS (strip->numPixels())
 
 Fader::Fader(Adafruit_NeoPixel *s)
@@ -11,13 +9,19 @@ Fader::Fader(Adafruit_NeoPixel *s)
   strip = s;
   targetColor = (uint8_t*)malloc(NUMPIXELS);
   fadingFlags = (uint8_t*)calloc(NUMPIXELS/8 + 1, 1); // +1 for rounding error
+  numActive = 0;
   fadeInOnly = false;
-  brightnessShift = 0;
+
+  fadeFraction = 0;
+  lastFadeMillis = 0;
+  setFadeTime(DEFAULT_FADETIME);
+  setFadeSteps(DEFAULT_FADESTEPS);
 }
 
 Fader::~Fader()
 {
   free(targetColor);
+  free(fadingFlags);
 }
 
 void Fader::reset()
@@ -52,7 +56,7 @@ void Fader::setFadeTarget(uint8_t pixelNum, uint32_t c)
   setFadeTarget(pixelNum, r, g, b);
 }
 
-void Fader::stopFading(uint8_t pixelNum)
+bool Fader::stopFading(uint8_t pixelNum)
 {
   // Get the current pixel color
   uint32_t c = strip->getPixelColor(pixelNum);
@@ -63,32 +67,59 @@ void Fader::stopFading(uint8_t pixelNum)
   // Reduce that to an 8-bit value, and set it as our target
   targetColor[pixelNum] = reduceColorTo8bit(r, g, b);
   // Set the strip's LED to match the target exactly
-  strip->setPixelColor(pixelNum, expandColorFrom8bit(targetColor[pixelNum]));
+  uint32_t snapped = expandColorFrom8bit(targetColor[pixelNum]);
+  strip->setPixelColor(pixelNum, snapped);
 
-  fadingFlags[pixelNum/8] &= ~(1 << (pixelNum % 8));
+  if (isFading(pixelNum)) {
+    clearFading(pixelNum);
+  }
+  return (snapped != c);
 }
 
 void Fader::startFading(uint8_t pixelNum)
 {
-  fadingFlags[pixelNum/8] |= (1 << (pixelNum % 8));
+  if (!isFading(pixelNum)) {
+    fadingFlags[pixelNum/8] |= (1 << (pixelNum % 8));
+    numActive++;
+  }
+}
+
+void Fader::clearFading(uint8_t pixelNum)
+{
+  fadingFlags[pixelNum/8] &= ~(1 << (pixelNum % 8));
+  numActive--;
 }
 
-void Fader::setBrightnessShift(int8_t shift)
+void Fader::setFadeMode(bool fadeInOnly)
 {
-  // If the caller is limiting brightness, then we need to know what the significant bits are of each 
-  // color value - b/c we're also reducing color to 3 bits per channel (max). This tells us how many bits
-  // to shift down.
+  this->fadeInOnly = fadeInOnly;
+}
 
-  brightnessShift = shift;
+static uint8_t stepToward(uint8_t v, uint8_t target, uint8_t delta)
+{
+  if (v > target) {
+    return (v - target > delta) ? v - delta : target;
+  }
+  return (target - v > delta) ? v + delta : target;
 }
 
+void Fader::setFadeTime(uint16_t t)
+{
+  fadeTime = t;
+}
 
-void Fader::setFadeMode(bool fadeInOnly)
+void Fader::setFadeSteps(uint8_t s)
 {
-  fadeInOnly = fadeInOnly;
+  if (s == 0)
+    s = 1;
+  fadeSteps = s;
+  fadeRate = ((uint16_t)255 << 8) / s;
 }
 
-bool Fader::performFadeForOnePixel(uint8_t pixelNum)
+// Move each channel of the pixel up to 'delta' toward its target.
+// Returns true if the pixel has reached its target; *moved says whether
+// its color changed on the way.
+bool Fader::performFadeForOnePixel(uint8_t pixelNum, uint8_t delta, bool *moved)
 {
   // What color is the pixel right now?
   uint32_t c = strip->getPixelColor(pixelNum);
@@ -105,63 +136,81 @@ bool Fader::performFadeForOnePixel(uint8_t pixelNum)
   tg = (target >> 8 ) & 0xFF;
   tb = (target      ) & 0xFF;
 
-  if (r > tr) {
-    r--;
-  } else if (r < tr) {
-    r++;
-  }
-  if (b > tb) {
-    b--;
-  } else if (b < tb) {
-    b++;
-  }
-  if (g > tg) {
-    g--;
-  } else if (g < tg) {
-    g++;
-  }
+  uint8_t nr = stepToward(r, tr, delta);
+  uint8_t ng = stepToward(g, tg, delta);
+  uint8_t nb = stepToward(b, tb, delta);
 
   // Set the pixelData to the new value we want
-  strip->setPixelColor(pixelNum, r, g, b);
+  *moved = (nr != r || ng != g || nb != b);
+  if (*moved) {
+    strip->setPixelColor(pixelNum, nr, ng, nb);
+  }
+
+  return (nr == tr && ng == tg && nb == tb);
 }
 
 // One step in the fade action, to be called regularly. 
-// returns true if it updates any LEDs.
+// returns true if it changes the color of any LEDs.
 bool Fader::performFade()
 {
   bool retval = false;
   numExtinguishedLastFade = 0;
-  static unsigned long nextMillis = 0;
-
-  if (millis() >= nextMillis) {
-    for (uint8_t idx = 0; idx < NUMPIXELS; idx++) {
-      if (isFading(idx)) {
-	retval = true;
-	performFadeForOnePixel(idx);
-	
-	uint32_t c = strip->getPixelColor(idx);
-	uint32_t t = expandColorFrom8bit(targetColor[idx]);
-	if (c == t) {
-	  // We reached our target!
-	  if (targetColor[idx] == 0) {
-	    stopFading(idx);
-	    numExtinguishedLastFade++;
-	  } else {
-	    // And it's not black, so we finished fading in
-	    if (fadeInOnly) {
-	      stopFading(idx);
-	      numExtinguishedLastFade++; // where "Extinguished" seems to loosely mean "stoped fading"
-	    } else {
-	      // But we want to go back to black
-	      setFadeTarget(idx, 0, 0, 0);
-	    }
-	  }
-	}
-      }
+
+  unsigned long now = millis();
+  if (now - lastFadeMillis < fadeTime) {
+    return false;
+  }
+
+  // Catch up on every step that's come due since the last pass, so the
+  // fade's wall-clock duration doesn't depend on how often we're called.
+  unsigned long steps = 1;
+  if (fadeTime) {
+    steps = (now - lastFadeMillis) / fadeTime;
+    lastFadeMillis += steps * fadeTime;
+    if (steps > fadeSteps) {
+      steps = fadeSteps; // a full fade is as far as anything can go
     }
+  } else {
+    lastFadeMillis = now;
+  }
 
-    nextMillis = millis() + FADESTEPTIME;
+  uint32_t movement = fadeFraction + steps * fadeRate;
+  fadeFraction = movement & 0xFF;
+  movement >>= 8;
+  if (movement == 0) {
+    return false;
+  }
+  uint8_t delta = (movement > 255) ? 255 : movement;
+
+  // Only the pixels that are fading, a byte of flags at a time
+  for (uint16_t i = 0; i < NUMPIXELS && numActive; i += 8) {
+    uint8_t bits = fadingFlags[i/8];
+    while (bits) {
+      uint8_t idx = i + __builtin_ctz(bits);
+      bits &= bits - 1; // clear the lowest set bit
+      bool moved;
+
+      bool reached = performFadeForOnePixel(idx, delta, &moved);
+      retval |= moved;
+      if (reached) {
+        // We reached our target!
+        if (targetColor[idx] == 0) {
+          clearFading(idx);
+          numExtinguishedLastFade++;
+        } else {
+          // And it's not black, so we finished fading in
+          if (fadeInOnly) {
+            clearFading(idx);
+            numExtinguishedLastFade++; // where "Extinguished" seems to loosely mean "stoped fading"
+          } else {
+            // But we want to go back to black
+            setFadeTarget(idx, 0, 0, 0);
+          }
+        }
+      }
+    }
   }
+
   return retval;
 }
 
@@ -177,6 +226,33 @@ bool Fader::isFading(uint8_t pixelNum)
   return (fadingFlags[pixelNum/8] & (1 << (pixelNum % 8)));
 }
 
+int16_t Fader::randomIdlePixel()
+{
+  uint16_t numIdle = NUMPIXELS - numActive;
+  if (numIdle == 0)
+    return -1;
+
+  // Pick the n'th idle pixel, skipping whole bytes of fadingFlags at a time
+  uint16_t n = random(numIdle);
+  for (uint16_t i = 0; i < NUMPIXELS; i += 8) {
+    uint8_t idleBits = ~fadingFlags[i/8];
+    if (NUMPIXELS - i < 8) {
+      idleBits &= (1 << (NUMPIXELS - i)) - 1; // past the end of the strip
+    }
+
+    uint8_t count = __builtin_popcount(idleBits);
+    if (n >= count) {
+      n -= count;
+      continue;
+    }
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      if ((idleBits & (1 << bit)) && n-- == 0) {
+        return i + bit;
+      }
+    }
+  }
+  return -1; // NOTREACHED
+}
 
 uint8_t Fader::reduceColorTo8bit(uint8_t r, uint8_t g, uint8_t b)
 {
@@ -184,9 +260,9 @@ uint8_t Fader::reduceColorTo8bit(uint8_t r, uint8_t g, uint8_t b)
   // NOTE: could make it 3/3/2 R/G/B with a loss in the relative precision 
   // between the color channels; not sure if that would be palatable though.
   return (
-    ((r >> (2-brightnessShift)) & 0x30) |
-    ((g >> (4-brightnessShift)) & 0x0C) |
-    ((b >> (6-brightnessShift)) & 0x03)
+    ((r >> 2) & 0x30) |
+    ((g >> 4) & 0x0C) |
+    ((b >> 6) & 0x03)
     );
 }
 
@@ -195,9 +271,9 @@ uint32_t Fader::expandColorFrom8bit(uint8_t c)
   // Losing precision, return a color to a 32-bit form
   uint32_t r, g, b;
 
-  r = (c & 0x30) << (2-brightnessShift);
-  g = (c & 0x0C) << (4-brightnessShift);
-  b = (c & 0x03) << (6-brightnessShift);
+  r = (c & 0x30) << 2;
+  g = (c & 0x0C) << 4;
+  b = (c & 0x03) << 6;
 
   return (r << 16) | (g << 8) | (b);
 }
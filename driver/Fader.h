@@ -6,13 +6,23 @@
  * the expense of CPU time. It is bound to the size of a byte, so cannot 
  * handle more than 256 LEDs as coded (cf. numPixels).
  *
- * We have sacrificed the fadeTime and have to accept a fixed stepwise 
- * increment based on targetColor; we have sacrificed precision of the target
- * color; we have sacrificed CPU time to calculate the bitwise indexes; and 
- * we have sacrificed in the direction code size and complexity. But for a 
+ * We have sacrificed per-pixel fade durations: every channel of every 
+ * pixel moves toward its target at the same rate, set by setFadeTime() 
+ * (mS per step) and setFadeSteps() (steps for a full 0-255 swing), and 
+ * kept as 8.8 fixed point so the rate is exact for any step count. Fades 
+ * follow millis(), not loop() passes, so a heavy mode doesn't slow them 
+ * down. We have sacrificed precision of the target color; we have 
+ * sacrificed CPU time to calculate the bitwise indexes; and we have 
+ * sacrificed in the direction code size and complexity. But for a 
  * device that only has 1500 bytes of RAM, this buys us a significant chunk 
  * of RAM.
  *
+ * Beyond the target color we keep only a bit per pixel, set while it's 
+ * fading. performFade() walks that mask a byte at a time, skipping bytes 
+ * with nothing fading, so it only touches pixels that are actually 
+ * moving; and the idle pixels are found from it too (a popcount per 
+ * byte), so picking a random idle pixel never has to guess.
+ *
  */
 
 class Fader {
@@ -27,26 +37,29 @@ class Fader {
   void setFadeTarget(uint8_t pixelNum, uint8_t r, uint8_t g, uint8_t b);
   void setFadeTarget(uint8_t pixelNum, uint32_t c);
 
-  void stopFading(uint8_t pixelNum);
+  bool stopFading(uint8_t pixelNum); // true if that changed the pixel
   void startFading(uint8_t pixelNum);
 
-  void setBrightnessShift(int8_t shift);
-
   void setFadeMode(bool fadeInOnly);
   void setFadeTime(uint16_t t);
   void setFadeSteps(uint8_t s);
 
-  bool performFadeForOnePixel(uint8_t pixelNum);
+  bool performFadeForOnePixel(uint8_t pixelNum, uint8_t delta, bool *moved);
   bool performFade();
 
   uint8_t howManyWentOut();
 
   bool isFading(uint8_t pixelNum);
 
+  // Returns a random pixel that isn't fading, or -1 if they all are.
+  int16_t randomIdlePixel();
+
  protected:
   uint8_t reduceColorTo8bit(uint8_t r, uint8_t g, uint8_t b);
   uint32_t expandColorFrom8bit(uint8_t c);
 
+  void clearFading(uint8_t pixelNum);
+
 
  private:
   // Private copy of strip, which holds data about the number of pixels...
@@ -59,8 +72,15 @@ class Fader {
   // bitwise flags for each pixel: is it fading in/out at all?
   uint8_t *fadingFlags; 
 
+  // How many of fadingFlags are set
+  uint16_t numActive;
+
   uint8_t numExtinguishedLastFade;
   bool fadeInOnly;
 
-  int8_t brightnessShift;
+  uint16_t fadeTime;    // mS per fade step
+  uint8_t fadeSteps;    // steps for a full 0-255 fade
+  uint16_t fadeRate;    // channel units per step, 8.8 fixed point
+  uint8_t fadeFraction; // fractional channel units carried to the next step
+  unsigned long lastFadeMillis;
 };
@@ -1,5 +1,9 @@
 #include "Life.h"
 
+// FNV-1a, a word at a time
+#define HASH_INIT 0x811C9DC5UL
+#define HASH_STEP(h, w) (((h) ^ (w)) * 0x01000193UL)
+
 static int random(int start, int endPlusOne)
 {
   float ret = (float)rand() / (float)RAND_MAX;
@@ -10,6 +14,8 @@ static int random(int start, int endPlusOne)
 
 Life::Life()
 {
+  universe = universeA;
+  newUniverse = universeB;
   init();
 }
 
@@ -19,8 +25,11 @@ Life::~Life()
 
 void Life::init()
 {
-  for (char x=0; x<LEDS_PER_RING; x++) {
-    for (char y=0; y<NUM_RINGS; y++) {
+  // Nothing has been shown yet, so every live cell will be a birth
+  memset(newUniverse, 0, sizeof(universeA));
+
+  for (uint8_t x=0; x<LEDS_PER_RING; x++) {
+    for (uint8_t y=0; y<NUM_RINGS; y++) {
       if (random(0,10) >= 8) {
 	setBit(universe, y, x);
       } else {
@@ -28,75 +37,137 @@ void Life::init()
       }
     }
   }
+
+  hash = hashUniverse();
+  resetCycleCheck();
+}
+
+static void showBits(uint8_t y, uint32_t bits, lightPixelFunc f, unsigned long v)
+{
+  while (bits) {
+    uint8_t x = __builtin_ctzl(bits);
+    f(y, x, v);
+    bits &= bits - 1; // clear the lowest set bit
+  }
 }
 
-bool Life::show(lightPixelFunc f, unsigned long v)
+bool Life::showChanges(lightPixelFunc f, unsigned long bornValue, unsigned long diedValue)
 {
   bool changed = false;
-  for (char y=0; y<NUM_RINGS; y++) {
-    for (char x=0; x<LEDS_PER_RING; x++) {
-      if (getBit(universe, y, x)) {
-	f(y, x, v);
-	changed = true;
-      }
-    }
+  for (uint8_t y=0; y<NUM_RINGS; y++) {
+    uint32_t born = universe[y] & ~newUniverse[y];
+    uint32_t died = newUniverse[y] & ~universe[y];
+    showBits(y, born, f, bornValue);
+    showBits(y, died, f, diedValue);
+    changed |= (born | died) != 0;
+
+    // Remember what we've shown
+    newUniverse[y] = universe[y];
   }
 
   return changed;
 }
 
+// Rotate a ring's cells by one position, wrapping around the ring
+static inline uint32_t ringLeft(uint32_t v)
+{
+  return ((v << 1) | (v >> (LEDS_PER_RING-1))) & RING_MASK;
+}
+
+static inline uint32_t ringRight(uint32_t v)
+{
+  return ((v >> 1) | (v << (LEDS_PER_RING-1))) & RING_MASK;
+}
+
+// Compute the next generation of all 24 cells in a ring at once. The
+// eight neighbors of each cell are summed with bitwise adders: each row
+// contributes a ones bit and a twos bit per cell, and a cell lives if
+// the total is 3, or 2 and it was already alive.
 uint8_t Life::evolve()
 {
   uint8_t changecount = 0;
-
-  
-  for (char y=0; y<NUM_RINGS; y++) {
-    for (char x=0; x<LEDS_PER_RING; x++) {
-      
-      // Count the neighbors
-      int n = countNeighborsWithWraparound(x,y);
-      
-      // implement the rules
-      if (getBit(universe, y, x)) {
-	// Any live cell with < 2 live neighbors dies.
-	// Any live cell with 2-3 neighbors is good.
-	// Any live cell with > 3 neighbors dies.
-	if (n == 2 || n == 3) {
-	  setBit(newUniverse, y, x);
-	} else {
-	  clearBit(newUniverse, y, x);
-	}
-      }
-      // Any dead cell with == 3 neighbors becomes live.
-      else if (n == 3) {
-	setBit(newUniverse, y, x);
-      } else {
-	// (else it stays dead)
-	clearBit(newUniverse, y, x);
-      }
-    }
+  uint32_t newHash = HASH_INIT;
+
+  for (uint8_t y=0; y<NUM_RINGS; y++) {
+    uint32_t above = universe[(y + NUM_RINGS - 1) % NUM_RINGS];
+    uint32_t here = universe[y];
+    uint32_t below = universe[(y + 1) % NUM_RINGS];
+
+    // Rows above and below: three cells each
+    uint32_t l = ringLeft(above), r = ringRight(above);
+    uint32_t aboveOnes = l ^ above ^ r;
+    uint32_t aboveTwos = (l & above) | (l & r) | (above & r);
+    l = ringLeft(below);
+    r = ringRight(below);
+    uint32_t belowOnes = l ^ below ^ r;
+    uint32_t belowTwos = (l & below) | (l & r) | (below & r);
+    // This row: just the two side neighbors
+    l = ringLeft(here);
+    r = ringRight(here);
+    uint32_t hereOnes = l ^ r;
+    uint32_t hereTwos = l & r;
+
+    uint32_t ones = aboveOnes ^ hereOnes ^ belowOnes;
+    uint32_t carry = (aboveOnes & hereOnes) | (aboveOnes & belowOnes) | (hereOnes & belowOnes);
+
+    // The total is ones + 2 * (the number of these four twos bits that are
+    // set); 2 or 3 neighbors means exactly one of them is set.
+    uint32_t x1 = aboveTwos ^ belowTwos;
+    uint32_t x2 = hereTwos ^ carry;
+    uint32_t moreThanOne = (aboveTwos & belowTwos) | (hereTwos & carry) | (x1 & x2);
+    uint32_t exactlyOne = (x1 ^ x2) & ~moreThanOne;
+
+    uint32_t next = exactlyOne & (ones | here);
+    newUniverse[y] = next;
+    changecount += __builtin_popcountl(here ^ next);
+    newHash = HASH_STEP(newHash, next);
   }
-  
-  // Put the new universe in place, counting the number
-  // of changes
-  for (char y=0; y<NUM_RINGS; y++) {
-    for (char x=0; x<LEDS_PER_RING; x++) {
-      uint8_t oldState = getBit(universe, y, x);
-      if (getBit(newUniverse, y, x)) {
-	if (!oldState)
-	  changecount++;
-        setBit(universe, y, x);
-      } else {
-	if (oldState)
-	  changecount++;
-        clearBit(universe, y, x);
-      }
+
+  // Put the new universe in place
+  uint32_t *t = universe;
+  universe = newUniverse;
+  newUniverse = t;
+  hash = newHash;
+
+  // Brent: compare against the tortoise, which jumps forward to the
+  // current generation after waiting twice as long as it did last time
+  // (capped, so a late cycle is still caught promptly).
+  cycling = (hash == tortoise);
+  if (!cycling) {
+    if (lambda == power) {
+      tortoise = hash;
+      if (power < MAX_CYCLE_CHECK)
+        power *= 2;
+      lambda = 0;
     }
+    lambda++;
   }
-  
+
   return changecount;
 }
 
+bool Life::inCycle()
+{
+  return cycling;
+}
+
+uint32_t Life::hashUniverse()
+{
+  uint32_t h = HASH_INIT;
+  for (uint8_t y=0; y<NUM_RINGS; y++) {
+    h = HASH_STEP(h, universe[y]);
+  }
+  return h;
+}
+
+void Life::resetCycleCheck()
+{
+  tortoise = hash;
+  power = 1;
+  lambda = 1;
+  cycling = false;
+}
+
 void Life::addGlider(uint8_t x, uint8_t y, uint8_t rotation)
 {
   // 3x3 array of glider, little-bittian
@@ -171,36 +242,7 @@ void Life::addEntropy()
     // Block-laying switch engine
     addSwitch(x, y, random(0,4));
   }
-}
 
-uint8_t Life::countNeighborsWithWraparound(uint8_t x, uint8_t y)
-{
-  uint8_t n = 0;
-  for (char y1 = y-1; y1 <= y+1; y1++) {
-    for (char x1 = x-1; x1 <= x + 1; x1++) {
-      if (x1 != x || y1 != y) {
-	if (getBit(universe,y1 % NUM_RINGS,x1 % LEDS_PER_RING)) n++;
-      }
-    }
-  }
-  return n;
-}
-
-uint8_t Life::CRC8()
-{
-  uint8_t crc = 0x00;
-  uint8_t len = NUM_RINGS * LEDS_PER_RING / 8;
-  uint8_t *p = universe;
-  while (len--) {
-    uint8_t b = *p++;
-    for (uint8_t bit = 8; bit; bit--)
-      {
-	uint8_t sum = (crc ^ b) & 0x01;
-	crc >>= 1;
-	if (sum)
-	  crc ^= 0x8C;
-	b >>= 1;
-      }
-  }
-  return crc;
+  hash = hashUniverse();
+  resetCycleCheck();
 }
@@ -5,10 +5,16 @@ typedef unsigned char uint8_t;
 #define NUM_RINGS 8
 #define LEDS_PER_RING 24
 
-// bitwise packing macros for Life mode, so we're only using 1 bit per pixel...
-#define getBit(u,y,x) (u[(y*LEDS_PER_RING+x)/8] & (1<<((y*LEDS_PER_RING+x)%8)))
-#define setBit(u,y,x) (u[(y*LEDS_PER_RING+x)/8] |= (1<<((y*LEDS_PER_RING+x)%8)))
-#define clearBit(u,y,x) (u[(y*LEDS_PER_RING+x)/8] &= ~(1<<((y*LEDS_PER_RING+x)%8)))
+// bitwise packing macros for Life mode, so we're only using 1 bit per pixel.
+// Each ring is one word, with pixel x in bit x.
+#define getBit(u,y,x) (u[y] & (1UL<<(x)))
+#define setBit(u,y,x) (u[y] |= (1UL<<(x)))
+#define clearBit(u,y,x) (u[y] &= ~(1UL<<(x)))
+
+#define RING_MASK ((1UL << LEDS_PER_RING) - 1)
+
+// Longest cycle (in generations) that inCycle() is guaranteed to catch
+#define MAX_CYCLE_CHECK 256
 
 #define unpackBit(u, y, x, width) (u[(y*width+x)/8] & (1<<((y*width+x)%8)))
 
@@ -20,19 +26,35 @@ class Life {
   ~Life();
   
   void init();
-  bool show(lightPixelFunc f, unsigned long v); // callback function and callback value
+  // Only the cells that changed since the last showChanges: born cells
+  // get bornValue, dead ones get diedValue.
+  bool showChanges(lightPixelFunc f, unsigned long bornValue, unsigned long diedValue);
   uint8_t evolve();
 
   void addEntropy();
 
-  uint8_t CRC8();
+  // Did the last evolve() produce a generation we've seen recently?
+  bool inCycle();
 
  private:
-  uint8_t countNeighborsWithWraparound(uint8_t x,uint8_t y);
   void addGlider(uint8_t x, uint8_t y, uint8_t rotation);
   void addSwitch(uint8_t x, uint8_t y, uint8_t rotation);
+  uint32_t hashUniverse();
+  void resetCycleCheck();
+
+
+  // Two generations, swapped by evolve()
+  uint32_t universeA[NUM_RINGS];
+  uint32_t universeB[NUM_RINGS];
 
+  uint32_t *universe;    // bits for display
+  uint32_t *newUniverse; // bits for evolution; between evolve() and the
+                         // next showChanges(), the generation last shown
 
-  uint8_t universe[NUM_RINGS*LEDS_PER_RING/8]; // bits for display
-  uint8_t newUniverse[NUM_RINGS*LEDS_PER_RING/8]; // bits for evolution
+  // Brent's cycle detection, over a hash of each generation
+  uint32_t hash;         // of the current universe
+  uint32_t tortoise;     // hash of the generation we're comparing against
+  uint16_t power;        // how many generations the tortoise waits
+  uint16_t lambda;       // generations since the tortoise last moved
+  bool cycling;
 };
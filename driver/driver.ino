@@ -11,6 +11,7 @@
 #include <RingBuffer.h>
 #include "RingPixels.h"
 #include "Life.h"
+#include <HSV.h>       // in this repository's libraries/ directory
 
 #define ENQ 5 // ASCII character 5, "Enquire"
 
@@ -21,6 +22,7 @@
 #define WS2812PIN 6
 #define CTSPIN 3
 #define RAMPIN 10 // /SS on SPI RAM
+#define RAMSIZE 131072UL // 128KB (1024 Kbit) device
 
 // Serial SRAM commands
 #define RAMREAD 0x03
@@ -51,7 +53,8 @@ enum runmode {
   TardisPillarMode,
   LifeMode,
   RotateMode,
-  TestMode
+  TestMode,
+  AnimationMode
 };
 
 runmode current_mode;
@@ -97,13 +100,17 @@ struct _ModeData {
       bool direction; // true = up; false = down
       int8_t nextRing;
     } tardisPillar;
-    struct _life {
-      uint8_t lastFingerprints[4];
-    } life;
     struct _test {
-      uint32_t testAddress;
+      uint32_t testAddress; // how far through this element we are
+      uint8_t element;      // which March element we're running
       bool hasFailed;
+      unsigned long startMillis;
     } test;
+    struct _animation {
+      uint8_t frames;     // how many stored frames to loop through
+      uint8_t next;       // the frame to show next
+      unsigned long due;  // when to show it
+    } animation;
   } mode;
 };
 
@@ -133,6 +140,7 @@ bool tardisPillar();
 bool life();
 bool rotate();
 bool test();
+bool animate();
 
 bool wipeModeInit();
 bool chaseModeInit();
@@ -142,17 +150,31 @@ bool matrixModeInit();
 bool rawFadeInit();
 bool rawPixelInit();
 bool brightnessInit();
+bool brightnessScaleInit();
+bool gammaInit();
 bool dimtimeInit();
 bool rawColorInit();
 bool rawLedInit();
 bool lifeInit();
 bool testInit();
+bool paletteInit();
+bool frameInit();
+bool deltaFrameInit();
+bool storeFrameInit();
+bool animationInit();
+
+constexpr uint8_t triggerIndex(uint8_t t, uint8_t i);
 
 // Number of LEDs in a ring * 2 (for color info), +1 for the line number
 #define RINGBYTES (LEDS_PER_RING * 2 + 1)
 
-#define NUMMODES 21
-const modeDef modes[NUMMODES] = { 
+// A commandBytes of VARLEN means the byte after the trigger is the number
+// of bytes after it (at most MAX_VARLEN_BYTES, so it fits in serialBuffer)
+#define VARLEN 0xFF
+#define MAX_VARLEN_BYTES (RINGBYTES - 1)
+
+#define NUMMODES 28
+constexpr modeDef modes[NUMMODES] = { 
   /* Mode          trigger  bytes-reqd callback     delay     init 
    * ----             ---  ------     --------     -----     ----- */
   { OffMode,          '0', 0,         NULL,          0,      NULL },
@@ -168,6 +190,8 @@ const modeDef modes[NUMMODES] = {
   { InvalidMode,      'f', 1,         NULL,          0,      rawFadeInit  },
   { InvalidMode,      '1', 1,         NULL,          0,      rawPixelInit },
   { InvalidMode,      'b', 1,         NULL,          0,      brightnessInit },
+  { InvalidMode,      'B', 1,         NULL,          0,      brightnessScaleInit },
+  { InvalidMode,      'G', 1,         NULL,          0,      gammaInit    },
   { InvalidMode,      'd', 2,         NULL,          0,      dimtimeInit  },
   { InvalidMode,      'c', 3,         NULL,          0,      rawColorInit },
   { InvalidMode,      'L', RINGBYTES, NULL,          0,      rawLedInit   },
@@ -175,9 +199,33 @@ const modeDef modes[NUMMODES] = {
   { TardisPillarMode, '/', 0,         tardisPillar, 25,      NULL },
   { LifeMode,         'l', 0,         life,       1000,      lifeInit },
   { RotateMode,       '$', 0,         rotate,      150,      NULL },
-  { TestMode,         '`', 0,         test,         10,      testInit },
+  { TestMode,         '`', 0,         test,          0,      testInit },
+  { InvalidMode,      'P', VARLEN,    NULL,          0,      paletteInit  },
+  { InvalidMode,      'F', VARLEN,    NULL,          0,      frameInit    },
+  { InvalidMode,      'D', VARLEN,    NULL,          0,      deltaFrameInit },
+  { InvalidMode,      'S', 3,         NULL,          0,      storeFrameInit },
+  { AnimationMode,    'A', 1,         animate,       0,      animationInit },
 };
 
+// Serial commands are dispatched through triggerTable, which maps each
+// 7-bit trigger byte to its index in modes[] (or NO_TRIGGER). It's built
+// from modes[] by the compiler, so the two can't disagree.
+#define NO_TRIGGER 0xFF
+
+constexpr uint8_t triggerIndex(uint8_t t, uint8_t i)
+{
+  return (i == NUMMODES) ? NO_TRIGGER :
+    (modes[i].trigger == t) ? i : triggerIndex(t, i + 1);
+}
+
+#define TRIGGERS_4(t)  triggerIndex((t), 0), triggerIndex((t)+1, 0), triggerIndex((t)+2, 0), triggerIndex((t)+3, 0)
+#define TRIGGERS_16(t) TRIGGERS_4(t), TRIGGERS_4((t)+4), TRIGGERS_4((t)+8), TRIGGERS_4((t)+12)
+#define TRIGGERS_64(t) TRIGGERS_16(t), TRIGGERS_16((t)+16), TRIGGERS_16((t)+32), TRIGGERS_16((t)+48)
+const PROGMEM uint8_t triggerTable[128] = { TRIGGERS_64(0), TRIGGERS_64(64) };
+
+// The modeDef for current_mode, so loop() doesn't have to look it up
+const modeDef *currentModeDef = NULL;
+
 #define MATRIX_INIT (-random(10) - 27)
 #define MATRIX_BREAKPOINT 40
 //#define MATRIX_BREAKPOINT2 60
@@ -190,6 +238,16 @@ const PROGMEM unsigned char charData[96 + numberOfCustomCharacters][CHAR_WIDTH]
 #include "font_data.h"
 };
 
+// The color wheel (see Wheel()), precomputed: R, G, B for each position
+const PROGMEM uint8_t wheelData[256][3] = {
+#include "wheel_data.h"
+};
+
+// Gamma 2.8, for the output stage (see showFrame())
+const PROGMEM uint8_t gammaTable[256] = {
+#include "gamma_data.h"
+};
+
 // Offscreen pixel area that gets shifted onscreen (ring buffer)
 #define BACKINGPIXELSIZE 24
 RingPixels backingPixels(NUM_RINGS, BACKINGPIXELSIZE);
@@ -200,17 +258,69 @@ RingBuffer backingText(BACKINGTEXTSIZE);
 RingBuffer backingTextColor(BACKINGTEXTSIZE);
 RingBuffer serialBuffer(RINGBYTES + 1); // RINGBYTES is our largest command, so we shouldn't need a buffer bigger than that.
 
+// strip.show() blocks with interrupts off for ~6mS, so we only latch a
+// frame when a pixel has actually changed color since the last one.
+bool frameDirty = false;
+unsigned long framesPushed = 0;
+unsigned long framesSkipped = 0; // passes that claimed changes but had none
+
+// Scrolling modes (text, rotate) don't move pixels one at a time. They
+// bump pendingScroll, and address pixels through scrolledPixelIndex();
+// applyScroll() then rotates each ring's bytes in the framebuffer once
+// per frame.
+#define BYTES_PER_PIXEL 3
+#define RING_PIXEL_BYTES (LEDS_PER_RING * BYTES_PER_PIXEL)
+uint8_t pendingScroll = 0; // columns to rotate toward the higher pixel numbers
+
+// Output stage. Modes draw full-resolution color in to the framebuffer;
+// brightness and gamma are applied to the whole frame as it's latched
+// (see showFrame()). There's no RAM for a second framebuffer, so the
+// mode's frame is parked at the top of the SPI SRAM while the strip
+// shows the adjusted one.
 #define MAX_BRIGHTSHIFT 8
-byte brightnessShift = 0; // 0 = full bright; 8 = full dark. Shifts by 1 bit each time.
-
-// One byte of command, two bytes of address, then one byte of potential data w/ retval
-uint8_t ramTransaction(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e) {
-  SPI.transfer(a); // command
-  SPI.transfer(b); // 3 bytes of address
-  SPI.transfer(c);
-  SPI.transfer(d);
-  return SPI.transfer(e); // value and/or returned value
-}
+#define FRAME_BYTES (TOTAL_LEDS * BYTES_PER_PIXEL)
+#define FRAME_STASH_ADDR (RAMSIZE - FRAME_BYTES)
+uint8_t brightness = 255; // output scale; 255 = full bright, 0 = dark
+bool gammaCorrect = false;
+
+// Palette-indexed frames ('P', 'F' and 'D', in raw mode). A frame is
+// sent as one or more chunks, each starting with a flags byte; the
+// first has FRAME_FIRST, and the display isn't latched until the chunk
+// without FRAME_MORE arrives (or FRAME_HOLD_TIMEOUT mS pass without
+// one). Chunks of a frame whose first chunk we missed are dropped.
+// Pixel data is run bytes: the high nibble is the run length - 1, the
+// low nibble the palette index. Delta frames put a count of pixels to
+// leave alone before each run byte.
+#define PALETTE_SIZE 16
+#define FRAME_MORE  0x01
+#define FRAME_FIRST 0x02
+#define FRAME_HOLD_TIMEOUT 500
+uint16_t palette[PALETTE_SIZE]; // RGB565
+uint8_t frameCursor = 0;        // next pixel of the frame being received
+bool holdFrame = false;         // part-way through a frame; don't latch it
+bool frameStarted = false;      // have we seen this frame's first chunk?
+unsigned long frameChunkMillis = 0;
+
+// Animation store. The SPI SRAM below the frame stash holds frames for
+// AnimationMode to play back: each is a 2-byte delay in mS (high byte
+// first), then FRAME_BYTES of pixels exactly as they sit in the strip.
+#define ANIMATION_SLOT_BYTES (2 + FRAME_BYTES)
+#define ANIMATION_FRAMES (FRAME_STASH_ADDR / ANIMATION_SLOT_BYTES)
+
+// The test mode ('`') runs March C- over the whole SRAM, with 0x00/0xFF
+// as the data:
+//   up(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0); up(r0)
+// Each element goes a TEST_BLOCK burst at a time (read the block and
+// check it, then write it), so a cell's neighbors in the same block are
+// read before it's written rather than after. A pass covers
+// TEST_BLOCKS_PER_CALL blocks, so serial and the display keep going.
+#define TEST_ELEMENTS 6
+#define TEST_BLOCK 64
+#define TEST_BLOCKS_PER_CALL 16
+#define TEST_BYTES_MOVED (10 * RAMSIZE) // reads plus writes, over all elements
+
+uint8_t readRam(uint32_t a);
+void writeRam(uint32_t a, uint8_t d);
 
 void initRam()
 {
@@ -220,7 +330,7 @@ void initRam()
   digitalWrite(RAMPIN, LOW); // 25nS setup time req'd
 
   SPI.transfer(WRMR);
-  SPI.transfer(0x00); // "byte mode" per datasheet. 0x80 is page mode, 0x40 is sequential
+  SPI.transfer(0x40); // "sequential mode" per datasheet, so transfers can stream. 0x00 is byte mode, 0x80 is page mode
 
   digitalWrite(RAMPIN, HIGH);
   pinMode(RAMPIN, INPUT);
@@ -228,70 +338,72 @@ void initRam()
   SPI.endTransaction();
 }
 
-void eraseRam()
-{
-  // Initialize the ram contents with zeroes
-  for (uint32_t i=0; i<131072; i++) { // 128KB (1024 Kbit) device
-    writeRam(i, 0);
-  } 
-}
-
-uint8_t readRam(uint32_t a)
+// All RAM access is a burst: select the chip and send one command and
+// address, stream any number of bytes (the address auto-increments, and
+// wraps at the end of the device), then release the chip. RAMPIN is only
+// driven for the length of the burst so that the SPI pins stay free for
+// in-circuit programming.
+void ramBurstStart(uint8_t cmd, uint32_t a)
 {
   SPI.beginTransaction(SPISettings(14000000, MSBFIRST, SPI_MODE0));
   pinMode(RAMPIN, OUTPUT);
   digitalWrite(RAMPIN, LOW); // 25nS setup time req'd
 
-  uint8_t d = ramTransaction(RAMREAD, (a>>16) & 0xFF, (a>>8) & 0xFF, a&0xFF, 0);
+  SPI.transfer(cmd);
+  SPI.transfer((a>>16) & 0xFF); // 3 bytes of address
+  SPI.transfer((a>>8) & 0xFF);
+  SPI.transfer(a & 0xFF);
+}
 
+void ramBurstEnd()
+{
   digitalWrite(RAMPIN, HIGH);
   pinMode(RAMPIN, INPUT);
   SPI.endTransaction();
+}
 
-  return d;
+void readRamBlock(uint32_t a, uint8_t *d, uint16_t n)
+{
+  ramBurstStart(RAMREAD, a);
+  while (n--) {
+    *d++ = SPI.transfer(0);
+  }
+  ramBurstEnd();
 }
 
-void writeRam(uint32_t a, uint8_t d)
+void writeRamBlock(uint32_t a, const uint8_t *d, uint16_t n)
 {
-  SPI.beginTransaction(SPISettings(14000000, MSBFIRST, SPI_MODE0));
-  pinMode(RAMPIN, OUTPUT);
-  digitalWrite(RAMPIN, LOW); // 25nS setup time req'd
+  ramBurstStart(RAMWRITE, a);
+  while (n--) {
+    SPI.transfer(*d++);
+  }
+  ramBurstEnd();
+}
 
-  ramTransaction(RAMWRITE, (a>>16) & 0xFF, (a>>8) & 0xFF, a&0xFF, d);
+void fillRam(uint32_t a, uint8_t v, uint32_t n)
+{
+  ramBurstStart(RAMWRITE, a);
+  while (n--) {
+    SPI.transfer(v);
+  }
+  ramBurstEnd();
+}
 
-  digitalWrite(RAMPIN, HIGH);
-  pinMode(RAMPIN, INPUT);
-  SPI.endTransaction();
+void eraseRam()
+{
+  fillRam(0, 0, RAMSIZE);
 }
 
-uint32_t brightnessControlled(uint32_t color)
+uint8_t readRam(uint32_t a)
 {
-  if (brightnessShift) {
-    uint16_t r =((color >> 16) & 0xFF);
-    uint16_t g = ((color >>  8) & 0xFF);
-    uint16_t b = ((color      ) & 0xFF);
-    
-    r >>= brightnessShift;
-    g >>= brightnessShift;
-    b >>= brightnessShift;
-    
-    color = r;
-    color <<= 8;
-    color |= g;
-    color <<= 8;
-    color |= b;
-  }
-  return color;
+  uint8_t d;
+  readRamBlock(a, &d, 1);
+  return d;
 }
 
-uint32_t brightnessControlled(uint16_t r, uint16_t g, uint16_t b)
+void writeRam(uint32_t a, uint8_t d)
 {
-  if (brightnessShift) {
-    r >>= brightnessShift;
-    g >>= brightnessShift;
-    b >>= brightnessShift;
-  }
-  return strip.Color(r, g, b);
+  writeRamBlock(a, &d, 1);
 }
 
 uint32_t colorFromSerialBuffer()
@@ -301,14 +413,111 @@ uint32_t colorFromSerialBuffer()
 		     serialBuffer.consumeByte());
 }
 
+// Set a pixel, noting whether that changes the frame
 void setPixelColor(uint16_t pixelIdx, uint32_t color)
 {
-  strip.setPixelColor(pixelIdx, brightnessControlled(color));
+  if (strip.getPixelColor(pixelIdx) != color) {
+    strip.setPixelColor(pixelIdx, color);
+    frameDirty = true;
+  }
 }
 
-void resetMode(runmode newMode)
+// Full brightness with no gamma leaves the frame as the mode drew it,
+// so it's latched straight from the framebuffer. Anything else costs
+// every latch two FRAME_BYTES bursts over SPI, parking the frame and
+// fetching it back. At least 1uS a byte at the 8MHz SPI clock, that's
+// over 2mS on top of strip.show(); the host bench has rainbowGamma at
+// about 8x rainbow's cost per frame.
+bool outputStagePassthrough()
+{
+  // The SRAM self-test owns all of the SRAM, frame stash included
+  return (brightness == 255 && !gammaCorrect) || current_mode == TestMode;
+}
+
+// Latch the frame, through the output stage if it's doing anything
+void showFrame()
+{
+  if (outputStagePassthrough()) {
+    strip.show();
+    return;
+  }
+
+  uint8_t *pixels = strip.getPixels();
+  writeRamBlock(FRAME_STASH_ADDR, pixels, FRAME_BYTES);
+
+  uint16_t scale = brightness + 1;
+  for (uint16_t i=0; i<FRAME_BYTES; i++) {
+    uint8_t v = pixels[i];
+    if (gammaCorrect)
+      v = pgm_read_byte(&gammaTable[v]);
+    pixels[i] = (v * scale) >> 8;
+  }
+  strip.show();
+
+  readRamBlock(FRAME_STASH_ADDR, pixels, FRAME_BYTES);
+}
+
+// Where column x of ring y currently lives in the framebuffer
+uint16_t scrolledPixelIndex(uint8_t y, uint8_t x)
+{
+  return y * LEDS_PER_RING + (x + LEDS_PER_RING - pendingScroll) % LEDS_PER_RING;
+}
+
+void applyScroll()
+{
+  if (!pendingScroll)
+    return;
+
+  uint8_t *pixels = strip.getPixels();
+  uint8_t shiftBytes = pendingScroll * BYTES_PER_PIXEL;
+  uint8_t saved[RING_PIXEL_BYTES];
+
+  for (uint8_t y=0; y<NUM_RINGS; y++) {
+    uint8_t *ring = &pixels[y * RING_PIXEL_BYTES];
+
+    // Rotating a ring that repeats with this period changes nothing
+    if (memcmp(ring, ring + shiftBytes, RING_PIXEL_BYTES - shiftBytes) == 0 &&
+        memcmp(ring + RING_PIXEL_BYTES - shiftBytes, ring, shiftBytes) == 0) {
+      continue;
+    }
+
+    memcpy(saved, ring + RING_PIXEL_BYTES - shiftBytes, shiftBytes);
+    memmove(ring + shiftBytes, ring, RING_PIXEL_BYTES - shiftBytes);
+    memcpy(ring, saved, shiftBytes);
+    frameDirty = true;
+  }
+
+  pendingScroll = 0;
+}
+
+const modeDef *findMode(runmode r)
+{
+  for (byte i=0; i<NUMMODES; i++) {
+    if (r == modes[i].mode) {
+      return &modes[i];
+    }
+  }
+  return NULL;
+}
+
+const modeDef *findModeByTrigger(uint8_t t)
+{
+  if (t >= sizeof(triggerTable))
+    return NULL;
+  uint8_t i = pgm_read_byte(&triggerTable[t]);
+  return (i == NO_TRIGGER) ? NULL : &modes[i];
+}
+
+// Switch modes without touching the display
+void setCurrentMode(runmode newMode)
 {
   current_mode = newMode;
+  currentModeDef = findMode(newMode);
+}
+
+void resetMode(runmode newMode)
+{
+  setCurrentMode(newMode);
   
   // prepare to run loops at the next opportunity  
   next_millis = 0;
@@ -332,12 +541,21 @@ void resetMode(runmode newMode)
   // For twinkle mode, clear the display before it starts
   if (newMode == TwinkleMode)
     strip.clear();
+
+  // The fader reset may have snapped pixels to their targets
+  frameDirty = true;
+  holdFrame = false;
+  frameStarted = false;
 }
 
 int freeMemory() {
+#ifdef __AVR__
   extern int __heap_start, *__brkval;
   int v;
   return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
+#else
+  return 0; // host build; no AVR heap to measure
+#endif
 }
 
 void setup() {
@@ -351,7 +569,6 @@ void setup() {
   initRam();
 
   fader = new Fader(&strip);
-  fader->setBrightnessShift(brightnessShift);
   
   Serial.begin(115200);
 
@@ -361,18 +578,6 @@ void setup() {
   digitalWrite(CTSPIN, HIGH);
 }
 
-int findRandomUnfadedPixel()
-{
-  // Try to find a random unfaded pixel 10 times. If we fail, then return -1.
-  for (int i=0; i<10; i++) {
-    uint8_t pixelNum = random(0, TOTAL_LEDS-1);
-    if (fader->isFading(pixelNum) == false) {
-      return pixelNum;
-    }
-  }
-  return -1;
-}
-
 bool twinkle()
 {
   bool didChangeAnything = false;
@@ -380,15 +585,15 @@ bool twinkle()
   for (int lightcount = 0; lightcount < TWINKLE_LIGHT_RATE; lightcount++) { // up to TWINKLE_LIGHT_RATE lights go on per iteration.
     if (modeData.mode.twinkle.numLit < MAX_TWINKLE_LIT) {
       // Light another if we can!
-      int idx = findRandomUnfadedPixel();
+      int16_t idx = fader->randomIdlePixel();
       if (idx != -1) {
         didChangeAnything = true;
         if (random(0,2) == 0) {
           // fade to white
-          fader->setFadeTarget(idx, brightnessControlled(255, 255, 196)); // a color mix that I liked as "white" with the pixels in 2014...
+          fader->setFadeTarget(idx, strip.Color(255, 255, 196)); // a color mix that I liked as "white" with the pixels in 2014...
         } else {
           // fade to red
-          fader->setFadeTarget(idx, brightnessControlled(255, 0, 0));
+          fader->setFadeTarget(idx, strip.Color(255, 0, 0));
         }
         modeData.mode.twinkle.numLit++;
       }
@@ -401,8 +606,8 @@ bool twinkle()
 uint32_t un565(uint16_t c)
 {
   uint8_t r = (c & 0xF800) >> 8;
-  uint8_t g = (c & 0x07E0) >> 5;
-  uint8_t b = (c & 0x001F);
+  uint8_t g = (c & 0x07E0) >> 3;
+  uint8_t b = (c & 0x001F) << 3;
 
   uint32_t col = r;
   col <<= 8;
@@ -413,12 +618,11 @@ uint32_t un565(uint16_t c)
   return col;
 }
 
-// return -1 for error, or # of bytes we consumed otherwise
+// 'd': mS per fade step, then the number of steps in a full fade
 bool dimtimeInit()
 {
-//  fader->setFadeTime(serialBuffer.consumeByte());
-//  fader->setFadeSteps(serialBuffer.consumeByte());
-// FIXME: now useless
+  fader->setFadeTime(serialBuffer.consumeByte());
+  fader->setFadeSteps(serialBuffer.consumeByte());
 
   return false; // we didn't change any pixels
 }
@@ -446,17 +650,24 @@ bool rawFadeInit()
   return false; // no pixels were changed
 }
 
+// Raw mode pixel update: fade to the color or set it outright, per 'f'
+void rawSetPixel(uint8_t pixelIdx, uint32_t color)
+{
+  if (modeData.mode.raw.fade) {
+    fader->setFadeTarget(pixelIdx, color);
+  } else {
+    if (fader->stopFading(pixelIdx))
+      frameDirty = true;
+    setPixelColor(pixelIdx, color);
+  }
+}
+
 bool rawPixelInit()
 {
   uint8_t pixelIndex = serialBuffer.consumeByte();
 
   if (current_mode == RawMode) {
-    if (modeData.mode.raw.fade) {
-      fader->setFadeTarget(pixelIndex, brightnessControlled(modeData.mode.raw.color));
-    } else {
-      fader->stopFading(pixelIndex);
-      setPixelColor(pixelIndex, modeData.mode.raw.color);
-    }
+    rawSetPixel(pixelIndex, modeData.mode.raw.color);
     return true; // we updated a pixel
   }
   return false; // no pixels were updated
@@ -494,20 +705,100 @@ bool rawLedInit()
            
     for (int i=0; i<LEDS_PER_RING; i++) {
       uint16_t pixelColor = (rb[i*2] << 8) | rb[i*2+1];
-      uint8_t pixelIdx = linenum * LEDS_PER_RING + i;
-
-      if (modeData.mode.raw.fade) {
-	fader->setFadeTarget(pixelIdx, brightnessControlled(un565(pixelColor)));
-      } else {
-	fader->stopFading(pixelIdx);
-	setPixelColor(pixelIdx, un565(pixelColor));
-      }
+      rawSetPixel(linenum * LEDS_PER_RING + i, un565(pixelColor));
     }
     return true; // we updated pixels
   }
   return false; // no pixels were updated
 }
 
+// 'P': length, first palette index, then RGB565 entries (high byte first)
+bool paletteInit()
+{
+  uint8_t len = serialBuffer.consumeByte();
+  if (!len)
+    return false;
+
+  uint8_t idx = serialBuffer.consumeByte();
+  len--;
+  for (; len >= 2; len -= 2, idx++) {
+    uint16_t c = serialBuffer.consumeByte() << 8;
+    c |= serialBuffer.consumeByte();
+    if (idx < PALETTE_SIZE)
+      palette[idx] = c;
+  }
+  if (len)
+    serialBuffer.consumeByte(); // half an entry
+
+  return false; // no pixels were changed
+}
+
+// Paint a palette run byte at frameCursor
+void frameRun(uint8_t run)
+{
+  uint32_t color = un565(palette[run & 0x0F]);
+  for (uint8_t n = (run >> 4) + 1; n && frameCursor < TOTAL_LEDS; n--) {
+    rawSetPixel(frameCursor++, color);
+  }
+}
+
+// Starts a frame chunk: consumes the flags byte, and returns false if
+// the chunk should just be discarded
+bool frameChunkStart(uint8_t len)
+{
+  if (!len)
+    return false;
+  uint8_t flags = serialBuffer.consumeByte();
+  if (current_mode != RawMode)
+    return false;
+
+  if (flags & FRAME_FIRST) {
+    frameCursor = 0;
+    frameStarted = true;
+  } else if (!frameStarted) {
+    return false; // the rest of a frame we didn't see start
+  }
+  holdFrame = (flags & FRAME_MORE) ? true : false;
+  frameStarted = holdFrame;
+  frameChunkMillis = millis();
+  return true;
+}
+
+// 'F': length, flags, then run bytes
+bool frameInit()
+{
+  uint8_t len = serialBuffer.consumeByte();
+  bool apply = frameChunkStart(len);
+
+  for (uint8_t i=1; i<len; i++) {
+    uint8_t run = serialBuffer.consumeByte();
+    if (apply)
+      frameRun(run);
+  }
+  return apply;
+}
+
+// 'D': length, flags, then pairs of (pixels to skip, run byte)
+bool deltaFrameInit()
+{
+  uint8_t len = serialBuffer.consumeByte();
+  bool apply = frameChunkStart(len);
+
+  for (uint8_t i=1; i<len; i++) {
+    uint8_t b = serialBuffer.consumeByte();
+    if (!apply)
+      continue;
+    if (i & 1) {
+      if (b > TOTAL_LEDS - frameCursor)
+        b = TOTAL_LEDS - frameCursor;
+      frameCursor += b;
+    } else {
+      frameRun(b);
+    }
+  }
+  return apply;
+}
+
 bool ringsModeInit()
 {
   modeData.repeat = serialBuffer.consumeByte();
@@ -543,12 +834,30 @@ bool matrixModeInit()
   return false;
 }
 
+// 'b': brightness as a right shift; 0 = full bright, 8 = full dark
 bool brightnessInit()
 {
-  brightnessShift = serialBuffer.consumeByte();
-  if (brightnessShift >= MAX_BRIGHTSHIFT)
-    brightnessShift = MAX_BRIGHTSHIFT;
-  fader->setBrightnessShift(brightnessShift);
+  uint8_t shift = serialBuffer.consumeByte();
+  if (shift >= MAX_BRIGHTSHIFT)
+    shift = MAX_BRIGHTSHIFT;
+  brightness = (256 >> shift) - 1;
+  frameDirty = true; // re-latch the current frame at the new brightness
+  return false;
+}
+
+// 'B': brightness as an output scale; 255 = full bright, 0 = dark
+bool brightnessScaleInit()
+{
+  brightness = serialBuffer.consumeByte();
+  frameDirty = true;
+  return false;
+}
+
+// 'G': gamma correction on (non-zero) or off
+bool gammaInit()
+{
+  gammaCorrect = serialBuffer.consumeByte() ? true : false;
+  frameDirty = true;
   return false;
 }
 
@@ -572,7 +881,7 @@ bool handleSerialCommands(const modeDef *m)
 
 bool wipe()
 {
-  fader->setFadeTarget(modeData.mode.wipe.pos, brightnessControlled(modeData.mode.wipe.color));
+  fader->setFadeTarget(modeData.mode.wipe.pos, modeData.mode.wipe.color);
   if (modeData.mode.wipe.pos == TOTAL_LEDS-1) {
     if ((current_mode == ChaseMode) && (modeData.repeat > 0)) {
       modeData.repeat--;
@@ -589,7 +898,7 @@ bool wipe()
 bool rings()
 {
   for (int idx = 0; idx < LEDS_PER_RING; idx++) {
-    fader->setFadeTarget((modeData.mode.rings.nextRing * LEDS_PER_RING) + idx, brightnessControlled(modeData.mode.rings.color));
+    fader->setFadeTarget((modeData.mode.rings.nextRing * LEDS_PER_RING) + idx, modeData.mode.rings.color);
   }
   if (modeData.mode.rings.direction) modeData.mode.rings.nextRing++;
   else modeData.mode.rings.nextRing--;
@@ -649,16 +958,10 @@ void addCharToBackingStore(char c, uint8_t backingColor)
 
 bool text()
 {
-  // Shift the display left; Pixel 1 gets pixel 0's data.
-
-  // Starting from the left edge, copy in whatever's to the right of that pixel (lower valued is right; 0,0 is bottom-right):
-  for (int x=LEDS_PER_RING-1; x>0; x--) {
-    for (int y=0; y<NUM_RINGS; y++) {
-      uint32_t c = strip.getPixelColor(y*LEDS_PER_RING+x-1);
-      // NOTE: no fading due to brightness here; we're copying
-      strip.setPixelColor(y*LEDS_PER_RING+x, c);
-    }
-  }
+  // Shift the display left; Pixel 1 gets pixel 0's data. (lower valued is
+  // right; 0,0 is bottom-right.) What was in the last column wraps around
+  // to column 0, which we're about to overwrite.
+  pendingScroll = (pendingScroll + 1) % LEDS_PER_RING;
 
   // Shift new data in to the display (in to pixel 0 on each row).
   byte column[NUM_RINGS];
@@ -670,7 +973,7 @@ bool text()
   }
 
   for (int y=0; y<NUM_RINGS; y++) {
-    setPixelColor(y*LEDS_PER_RING+0, colorFromBackingColor(column[y]));
+    setPixelColor(scrolledPixelIndex(y, 0), colorFromBackingColor(column[y]));
   }
 
   // If there is text to be placed in the backing pixels buffer, and there's room, do it
@@ -759,16 +1062,9 @@ bool matrix()
 // Input a value 0 to 255 to get a color value.
 // The colours are a transition r - g - b - back to r.
 uint32_t Wheel(byte WheelPos) {
-  WheelPos = 255 - WheelPos;
-  if(WheelPos < 85) {
-    return strip.Color(255 - WheelPos * 3, 0, WheelPos * 3);
-  }
-  if(WheelPos < 170) {
-    WheelPos -= 85;
-    return strip.Color(0, WheelPos * 3, 255 - WheelPos * 3);
-  }
-  WheelPos -= 170;
-  return strip.Color(WheelPos * 3, 255 - WheelPos * 3, 0);
+  return strip.Color(pgm_read_byte(&wheelData[WheelPos][0]),
+                     pgm_read_byte(&wheelData[WheelPos][1]),
+                     pgm_read_byte(&wheelData[WheelPos][2]));
 }
 
 bool theaterChase()
@@ -776,12 +1072,14 @@ bool theaterChase()
   modeData.mode.theaterChase.theater_state++;
   modeData.mode.theaterChase.theater_state %= 3;
   modeData.mode.theaterChase.rainbow_state++; // will roll over
+
+  // One color for every lit pixel this frame
+  uint32_t c = Wheel(modeData.mode.theaterChase.rainbow_state);
+  uint8_t phase = 0;
   for (int i=0; i<TOTAL_LEDS; i++) {
-    if ((i % 3) == modeData.mode.theaterChase.theater_state) {
-      setPixelColor(i, /*modeData.mode.theaterChase.color*/Wheel(modeData.mode.theaterChase.rainbow_state));
-    } else {
-      setPixelColor(i, 0);
-    }
+    setPixelColor(i, (phase == modeData.mode.theaterChase.theater_state) ? c : 0);
+    if (++phase == 3)
+      phase = 0;
   }
   return true;
 }
@@ -790,62 +1088,31 @@ bool rainbow()
 {
   modeData.mode.rainbow.state++; // will roll over
 
+  uint8_t pos = modeData.mode.rainbow.state;
   for (int i=0; i<TOTAL_LEDS; i++) {
-    uint32_t c = Wheel((modeData.mode.rainbow.state + i) & 0xFF);
-    setPixelColor(i, c);
+    setPixelColor(i, Wheel(pos++)); // pos rolls over, too
   }
   
   return true;
 }
 
-void
-hsv_to_rgb (int h, double s, double v,
-            uint8_t *r, uint8_t *g, uint8_t *b)
-{
-  double H, S, V, R, G, B;
-  double p1, p2, p3;
-  double f;
-  int i;
-
-  if (s < 0) s = 0;
-  if (v < 0) v = 0;
-  if (s > 1) s = 1;
-  if (v > 1) v = 1;
-  S = s; V = v;
-  H = (h % 360) / 60.0;
-  i = H;
-  f = H - i;
-  p1 = V * (1 - S);
-  p2 = V * (1 - (S * f));
-  p3 = V * (1 - (S * (1 - f)));
-  if      (i == 0) { R = V;  G = p3; B = p1; }
-  else if (i == 1) { R = p2; G = V;  B = p1; }
-  else if (i == 2) { R = p1; G = V;  B = p3; }
-  else if (i == 3) { R = p1; G = p2; B = V;  }
-  else if (i == 4) { R = p3; G = p1; B = V;  }
-  else             { R = V;  G = p1; B = p2; }
-  *r = R * 255;
-  *g = G * 255;
-  *b = B * 255;
-}
-
 bool tardis()
 {
   modeData.mode.tardis.state++;
 
   // Get the blue we want, at the brightness we want
   uint8_t r, g, b;
-  uint8_t brightness;
+  uint8_t level;
   if (modeData.mode.tardis.state <= 127) {
     // fading in from [0-127]
-    brightness = 2 * modeData.mode.tardis.state;
+    level = 2 * modeData.mode.tardis.state;
   } else {
     // fading out from [128-255]
-    brightness = 2 * (255 - modeData.mode.tardis.state);
+    level = 2 * (255 - modeData.mode.tardis.state);
     
   }
   
-  hsv_to_rgb(225, 1.0, (float)(brightness) / 256.0, &r, &g, &b);
+  hsv_to_rgb8(225, 255, level, &r, &g, &b);
   uint32_t c = strip.Color(r, g, b);
 
   for (int i=0; i<TOTAL_LEDS; i++) {
@@ -859,7 +1126,7 @@ bool tardisPillar()
   if (modeData.mode.tardisPillar.nextRing >= 0 &&
       modeData.mode.tardisPillar.nextRing <= NUM_RINGS-1) {
     for (int idx = 0; idx < LEDS_PER_RING; idx++) {
-      fader->setFadeTarget((modeData.mode.tardisPillar.nextRing * LEDS_PER_RING) + idx, brightnessControlled(strip.Color(0, 0, 255)));
+      fader->setFadeTarget((modeData.mode.tardisPillar.nextRing * LEDS_PER_RING) + idx, strip.Color(0, 0, 255));
     }
   }
   if (modeData.mode.tardisPillar.direction) modeData.mode.tardisPillar.nextRing++;
@@ -883,28 +1150,17 @@ bool lifeInit()
 
 void life_lightPixel(uint8_t y, uint8_t x, uint32_t v)
 {
-  fader->setFadeTarget(y * LEDS_PER_RING + x, brightnessControlled(v));
+  fader->setFadeTarget(y * LEDS_PER_RING + x, v);
 }
 
 bool life()
 {
-  fader->setFadeMode(true); // fade in only (which also does "out")
-  bool retval = lifeThing->show(life_lightPixel, 0xFF0000); // FIXME: color control could be better
-  if (lifeThing->evolve() < 5) {
-    lifeThing->addEntropy();
-  }
-
-  // See if we need to add some entropy. Keep track of the last few states' fingerprints, 
-  // for which we're using CRC8.
-  for (int8_t idx = sizeof(modeData.mode.life.lastFingerprints)-1; idx > 0; idx--) {
-    modeData.mode.life.lastFingerprints[idx] = modeData.mode.life.lastFingerprints[idx-1];
-  }
-  modeData.mode.life.lastFingerprints[0] = lifeThing->CRC8();
+  fader->setFadeMode(true); // fade in only; cells that die are faded out explicitly
+  bool retval = lifeThing->showChanges(life_lightPixel, 0xFF0000, 0); // FIXME: color control could be better
 
-  // Check to see if we've seen the current state (fingerprint) within the last few states.
-  for (int8_t idx = 1; idx < sizeof(modeData.mode.life.lastFingerprints); idx++) {
-    if (modeData.mode.life.lastFingerprints[0] == modeData.mode.life.lastFingerprints[idx])
-      lifeThing->addEntropy();
+  // Stir things up if the universe is dying off, or is stuck repeating itself
+  if (lifeThing->evolve() < 5 || lifeThing->inCycle()) {
+    lifeThing->addEntropy();
   }
   return retval;
 }
@@ -912,17 +1168,54 @@ bool life()
 // Rotate all the pixels around the display, right-to-left (which makes sense for trying to read text).
 bool rotate()
 {
-  for (int8_t y = 0; y < NUM_RINGS; y++) {
-    uint32_t t = strip.getPixelColor((y+1)*LEDS_PER_RING - 1); // last pixel of row y, which is the pixel before row y+1
+  // Each pixel takes the color of the one before it; the last wraps to #0.
+  pendingScroll = (pendingScroll + 1) % LEDS_PER_RING;
 
-    for (int8_t x = LEDS_PER_RING-1; x>0; x--) {
-      // Set the color based on the pixel next to the one we're looking at
-      strip.setPixelColor(y*LEDS_PER_RING+x, 
-			  strip.getPixelColor(y*LEDS_PER_RING+x-1));
-    }
-    // Finally, get pixel #0 from the pixel we saved @ the end
-    strip.setPixelColor(y * LEDS_PER_RING, t);
+  return true;
+}
+
+// 'S': frame number, then delay in mS (high byte first). Stores the
+// current display as that frame of the animation.
+bool storeFrameInit()
+{
+  uint8_t frame = serialBuffer.consumeByte();
+  uint8_t delayBytes[2];
+  delayBytes[0] = serialBuffer.consumeByte();
+  delayBytes[1] = serialBuffer.consumeByte();
+
+  if (frame < ANIMATION_FRAMES) {
+    uint32_t a = (uint32_t)frame * ANIMATION_SLOT_BYTES;
+    writeRamBlock(a, delayBytes, 2);
+    writeRamBlock(a + 2, strip.getPixels(), FRAME_BYTES);
   }
+  return false; // no pixels were changed
+}
+
+// 'A': number of stored frames to play, looping
+bool animationInit()
+{
+  modeData.mode.animation.frames = serialBuffer.consumeByte();
+  if (modeData.mode.animation.frames > ANIMATION_FRAMES)
+    modeData.mode.animation.frames = ANIMATION_FRAMES;
+  return false;
+}
+
+// Called every pass; each frame brings its own delay
+bool animate()
+{
+  if (!modeData.mode.animation.frames ||
+      millis() < modeData.mode.animation.due)
+    return false;
+
+  uint32_t a = (uint32_t)modeData.mode.animation.next * ANIMATION_SLOT_BYTES;
+  uint8_t delayBytes[2];
+  readRamBlock(a, delayBytes, 2);
+  readRamBlock(a + 2, strip.getPixels(), FRAME_BYTES);
+  frameDirty = true;
+
+  modeData.mode.animation.due = millis() + ((delayBytes[0] << 8) | delayBytes[1]);
+  if (++modeData.mode.animation.next >= modeData.mode.animation.frames)
+    modeData.mode.animation.next = 0;
 
   return true;
 }
@@ -930,37 +1223,91 @@ bool rotate()
 bool testInit()
 {
   modeData.mode.test.testAddress = 0;
+  modeData.mode.test.element = 0;
   modeData.mode.test.hasFailed = false;
+  modeData.mode.test.startMillis = millis();
 
   for (int i=0; i<TOTAL_LEDS; i++) {
-    strip.setPixelColor(i, 0);
+    setPixelColor(i, 0);
   }
   
   fader->setFadeMode(false); // fade in and out
   return true;
 }
 
+void testFailed(uint32_t a, uint8_t got, uint8_t expected)
+{
+  modeData.mode.test.hasFailed = true;
+  fader->setFadeTarget(a * TOTAL_LEDS / RAMSIZE, 0xFF0000);
+
+  Serial.print("SRAM failed at ");
+  Serial.print((unsigned long)a);
+  Serial.print(": read ");
+  Serial.print(got);
+  Serial.print(", expected ");
+  Serial.print(expected);
+  Serial.print(", after ");
+  Serial.print(millis() - modeData.mode.test.startMillis);
+  Serial.println(" mS");
+}
+
 bool test()
 {
-  if (modeData.mode.test.testAddress >= 0x01000000) {
+  if (modeData.mode.test.hasFailed ||
+      modeData.mode.test.element >= TEST_ELEMENTS) {
+    return false; // done; the result is on display
+  }
+
+  uint8_t e = modeData.mode.test.element;
+  bool descending = (e == 3 || e == 4);
+  uint8_t expected = (e == 2 || e == 4) ? 0xFF : 0x00;
+
+  uint8_t buf[TEST_BLOCK];
+  for (uint8_t n=0; n<TEST_BLOCKS_PER_CALL; n++) {
+    uint32_t a = modeData.mode.test.testAddress;
+    if (descending)
+      a = RAMSIZE - TEST_BLOCK - a;
+
+    if (e != 0) {
+      readRamBlock(a, buf, TEST_BLOCK);
+      for (uint8_t i=0; i<TEST_BLOCK; i++) {
+        uint8_t idx = descending ? TEST_BLOCK - 1 - i : i;
+        if (buf[idx] != expected) {
+          testFailed(a + idx, buf[idx], expected);
+          return true;
+        }
+      }
+    }
+    if (e != TEST_ELEMENTS - 1) {
+      fillRam(a, e ? ~expected : 0x00, TEST_BLOCK);
+    }
+
+    modeData.mode.test.testAddress += TEST_BLOCK;
+    if (modeData.mode.test.testAddress >= RAMSIZE) {
+      modeData.mode.test.testAddress = 0;
+      modeData.mode.test.element++;
+      break;
+    }
+  }
+
+  // The display is a progress bar over all of the elements
+  uint32_t done = (uint32_t)modeData.mode.test.element * RAMSIZE + modeData.mode.test.testAddress;
+  uint8_t pixel = done * TOTAL_LEDS / (TEST_ELEMENTS * RAMSIZE);
+  if (pixel < TOTAL_LEDS)
+    setPixelColor(pixel, 0x00FFFF);
+
+  if (modeData.mode.test.element == TEST_ELEMENTS) {
     // Success: all passed
     for (int i=0; i<TOTAL_LEDS; i++) {
       fader->setFadeTarget(i, 0x00FF00);
     }
-  } else {
-    writeRam(modeData.mode.test.testAddress, modeData.mode.test.testAddress & 0xFF);
-    uint8_t r = readRam(modeData.mode.test.testAddress);
-    if (r != (modeData.mode.test.testAddress & 0xFF)) {
-      modeData.mode.test.hasFailed = true;
-    }
-  
-    // Light up the pixel either white (passed) or red (failed)
-    uint8_t pixelNum = modeData.mode.test.testAddress % TOTAL_LEDS;
-    fader->setFadeTarget(pixelNum, modeData.mode.test.hasFailed ? 0xFF0000 : 0x00FFFF);
-  
-    if (!modeData.mode.test.hasFailed) {
-      modeData.mode.test.testAddress++;
-    }
+
+    unsigned long ms = millis() - modeData.mode.test.startMillis;
+    Serial.print("SRAM OK; ");
+    Serial.print(ms);
+    Serial.print(" mS, ");
+    Serial.print(ms ? TEST_BYTES_MOVED * 1000 / ms : 0UL);
+    Serial.println(" bytes/sec");
   }
 
   return true;
@@ -976,7 +1323,7 @@ bool textModeInputHandler(uint8_t c)
     escapeMode++;
     if (escapeMode == 2) {
       escapeMode = 0;
-      current_mode = RawMode;
+      setCurrentMode(RawMode);
       return false;
     }
     return true;
@@ -1005,31 +1352,13 @@ bool textModeInputHandler(uint8_t c)
   return true;
 }
 
-const modeDef *findMode(runmode r)
-{
-  for (byte i=0; i<NUMMODES; i++) {
-    if (r == modes[i].mode) {
-      return &modes[i];
-    }
-  }
-  return NULL;
-}
-
-const modeDef *findModeByTrigger(uint8_t t)
-{
-  for (byte i=0; i<NUMMODES; i++) {
-    if (t == modes[i].trigger) {
-      return &modes[i];
-    }
-  }
-  return NULL;
-}
-
 void loop()
 {
   bool changes = false; // Did we change any lights?
 
-  if (Serial.available() > 0) {
+  // Take everything that's arrived, so a whole command is usually parsed
+  // in one pass; bytes that arrive while we do are left for the next one
+  for (int avail = Serial.available(); avail > 0; avail--) {
     static bool ledState = false;
     ledState = !ledState;
     byte b = Serial.read();
@@ -1041,6 +1370,15 @@ void loop()
       const modeDef *d = findModeByTrigger(serialBuffer.peek(0));
       if (d) {
 	byte moreNeeded = d->commandBytes;
+	if (moreNeeded == VARLEN) {
+	  // The byte after the trigger says how many more follow it
+	  // (checked before adding one, which would wrap for 0xFF)
+	  if (serialBuffer.count() > 1 && serialBuffer.peek(1) > MAX_VARLEN_BYTES) {
+	    serialBuffer.consumeByte(); // can't be a command we know; resync
+	    continue;
+	  }
+	  moreNeeded = (serialBuffer.count() > 1) ? 1 + serialBuffer.peek(1) : 1;
+	}
 	if (serialBuffer.count() > moreNeeded) { // '>' because of the command byte itself
 	  serialBuffer.consumeByte();                 // drop the command byte
 	  digitalWrite(CTSPIN, LOW);                  // don't accept commands right now
@@ -1059,7 +1397,7 @@ void loop()
   }
 
   // Perform automated routine updates based on what mode we're currently in
-  const modeDef *m = findMode(current_mode);
+  const modeDef *m = currentModeDef;
   if (m && m->callback) {
     if (millis() >= next_millis) {
       changes |= m->callback();
@@ -1067,16 +1405,32 @@ void loop()
     }
   }
 
+  // Move the scrolled pixels in to place before the fader, which works in
+  // framebuffer order, looks at them
+  applyScroll();
+
   // Perform a fade update once per loop for anything that's fading
-  changes |= fader->performFade();
+  if (fader->performFade()) {
+    frameDirty = true;
+  }
 
-  if (changes && current_mode == TwinkleMode) {
+  if (current_mode == TwinkleMode) {
     // subtract the number that faded out last time 'round
     modeData.mode.twinkle.numLit -= fader->howManyWentOut();
   }
 
-  if (changes) {
-    strip.show();
+  // The rest of a frame that isn't coming; show what we have
+  if (holdFrame && millis() - frameChunkMillis >= FRAME_HOLD_TIMEOUT) {
+    holdFrame = false;
+    frameStarted = false;
+  }
+
+  if (frameDirty && !holdFrame) {
+    showFrame();
+    frameDirty = false;
+    framesPushed++;
+  } else if (changes) {
+    framesSkipped++;
   }
 }
 
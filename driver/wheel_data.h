@@ -0,0 +1,256 @@
+	{0xFF , 0x00 , 0x00 }, // 0
+	{0xFC , 0x03 , 0x00 }, // 1
+	{0xF9 , 0x06 , 0x00 }, // 2
+	{0xF6 , 0x09 , 0x00 }, // 3
+	{0xF3 , 0x0C , 0x00 }, // 4
+	{0xF0 , 0x0F , 0x00 }, // 5
+	{0xED , 0x12 , 0x00 }, // 6
+	{0xEA , 0x15 , 0x00 }, // 7
+	{0xE7 , 0x18 , 0x00 }, // 8
+	{0xE4 , 0x1B , 0x00 }, // 9
+	{0xE1 , 0x1E , 0x00 }, // 10
+	{0xDE , 0x21 , 0x00 }, // 11
+	{0xDB , 0x24 , 0x00 }, // 12
+	{0xD8 , 0x27 , 0x00 }, // 13
+	{0xD5 , 0x2A , 0x00 }, // 14
+	{0xD2 , 0x2D , 0x00 }, // 15
+	{0xCF , 0x30 , 0x00 }, // 16
+	{0xCC , 0x33 , 0x00 }, // 17
+	{0xC9 , 0x36 , 0x00 }, // 18
+	{0xC6 , 0x39 , 0x00 }, // 19
+	{0xC3 , 0x3C , 0x00 }, // 20
+	{0xC0 , 0x3F , 0x00 }, // 21
+	{0xBD , 0x42 , 0x00 }, // 22
+	{0xBA , 0x45 , 0x00 }, // 23
+	{0xB7 , 0x48 , 0x00 }, // 24
+	{0xB4 , 0x4B , 0x00 }, // 25
+	{0xB1 , 0x4E , 0x00 }, // 26
+	{0xAE , 0x51 , 0x00 }, // 27
+	{0xAB , 0x54 , 0x00 }, // 28
+	{0xA8 , 0x57 , 0x00 }, // 29
+	{0xA5 , 0x5A , 0x00 }, // 30
+	{0xA2 , 0x5D , 0x00 }, // 31
+	{0x9F , 0x60 , 0x00 }, // 32
+	{0x9C , 0x63 , 0x00 }, // 33
+	{0x99 , 0x66 , 0x00 }, // 34
+	{0x96 , 0x69 , 0x00 }, // 35
+	{0x93 , 0x6C , 0x00 }, // 36
+	{0x90 , 0x6F , 0x00 }, // 37
+	{0x8D , 0x72 , 0x00 }, // 38
+	{0x8A , 0x75 , 0x00 }, // 39
+	{0x87 , 0x78 , 0x00 }, // 40
+	{0x84 , 0x7B , 0x00 }, // 41
+	{0x81 , 0x7E , 0x00 }, // 42
+	{0x7E , 0x81 , 0x00 }, // 43
+	{0x7B , 0x84 , 0x00 }, // 44
+	{0x78 , 0x87 , 0x00 }, // 45
+	{0x75 , 0x8A , 0x00 }, // 46
+	{0x72 , 0x8D , 0x00 }, // 47
+	{0x6F , 0x90 , 0x00 }, // 48
+	{0x6C , 0x93 , 0x00 }, // 49
+	{0x69 , 0x96 , 0x00 }, // 50
+	{0x66 , 0x99 , 0x00 }, // 51
+	{0x63 , 0x9C , 0x00 }, // 52
+	{0x60 , 0x9F , 0x00 }, // 53
+	{0x5D , 0xA2 , 0x00 }, // 54
+	{0x5A , 0xA5 , 0x00 }, // 55
+	{0x57 , 0xA8 , 0x00 }, // 56
+	{0x54 , 0xAB , 0x00 }, // 57
+	{0x51 , 0xAE , 0x00 }, // 58
+	{0x4E , 0xB1 , 0x00 }, // 59
+	{0x4B , 0xB4 , 0x00 }, // 60
+	{0x48 , 0xB7 , 0x00 }, // 61
+	{0x45 , 0xBA , 0x00 }, // 62
+	{0x42 , 0xBD , 0x00 }, // 63
+	{0x3F , 0xC0 , 0x00 }, // 64
+	{0x3C , 0xC3 , 0x00 }, // 65
+	{0x39 , 0xC6 , 0x00 }, // 66
+	{0x36 , 0xC9 , 0x00 }, // 67
+	{0x33 , 0xCC , 0x00 }, // 68
+	{0x30 , 0xCF , 0x00 }, // 69
+	{0x2D , 0xD2 , 0x00 }, // 70
+	{0x2A , 0xD5 , 0x00 }, // 71
+	{0x27 , 0xD8 , 0x00 }, // 72
+	{0x24 , 0xDB , 0x00 }, // 73
+	{0x21 , 0xDE , 0x00 }, // 74
+	{0x1E , 0xE1 , 0x00 }, // 75
+	{0x1B , 0xE4 , 0x00 }, // 76
+	{0x18 , 0xE7 , 0x00 }, // 77
+	{0x15 , 0xEA , 0x00 }, // 78
+	{0x12 , 0xED , 0x00 }, // 79
+	{0x0F , 0xF0 , 0x00 }, // 80
+	{0x0C , 0xF3 , 0x00 }, // 81
+	{0x09 , 0xF6 , 0x00 }, // 82
+	{0x06 , 0xF9 , 0x00 }, // 83
+	{0x03 , 0xFC , 0x00 }, // 84
+	{0x00 , 0xFF , 0x00 }, // 85
+	{0x00 , 0xFC , 0x03 }, // 86
+	{0x00 , 0xF9 , 0x06 }, // 87
+	{0x00 , 0xF6 , 0x09 }, // 88
+	{0x00 , 0xF3 , 0x0C }, // 89
+	{0x00 , 0xF0 , 0x0F }, // 90
+	{0x00 , 0xED , 0x12 }, // 91
+	{0x00 , 0xEA , 0x15 }, // 92
+	{0x00 , 0xE7 , 0x18 }, // 93
+	{0x00 , 0xE4 , 0x1B }, // 94
+	{0x00 , 0xE1 , 0x1E }, // 95
+	{0x00 , 0xDE , 0x21 }, // 96
+	{0x00 , 0xDB , 0x24 }, // 97
+	{0x00 , 0xD8 , 0x27 }, // 98
+	{0x00 , 0xD5 , 0x2A }, // 99
+	{0x00 , 0xD2 , 0x2D }, // 100
+	{0x00 , 0xCF , 0x30 }, // 101
+	{0x00 , 0xCC , 0x33 }, // 102
+	{0x00 , 0xC9 , 0x36 }, // 103
+	{0x00 , 0xC6 , 0x39 }, // 104
+	{0x00 , 0xC3 , 0x3C }, // 105
+	{0x00 , 0xC0 , 0x3F }, // 106
+	{0x00 , 0xBD , 0x42 }, // 107
+	{0x00 , 0xBA , 0x45 }, // 108
+	{0x00 , 0xB7 , 0x48 }, // 109
+	{0x00 , 0xB4 , 0x4B }, // 110
+	{0x00 , 0xB1 , 0x4E }, // 111
+	{0x00 , 0xAE , 0x51 }, // 112
+	{0x00 , 0xAB , 0x54 }, // 113
+	{0x00 , 0xA8 , 0x57 }, // 114
+	{0x00 , 0xA5 , 0x5A }, // 115
+	{0x00 , 0xA2 , 0x5D }, // 116
+	{0x00 , 0x9F , 0x60 }, // 117
+	{0x00 , 0x9C , 0x63 }, // 118
+	{0x00 , 0x99 , 0x66 }, // 119
+	{0x00 , 0x96 , 0x69 }, // 120
+	{0x00 , 0x93 , 0x6C }, // 121
+	{0x00 , 0x90 , 0x6F }, // 122
+	{0x00 , 0x8D , 0x72 }, // 123
+	{0x00 , 0x8A , 0x75 }, // 124
+	{0x00 , 0x87 , 0x78 }, // 125
+	{0x00 , 0x84 , 0x7B }, // 126
+	{0x00 , 0x81 , 0x7E }, // 127
+	{0x00 , 0x7E , 0x81 }, // 128
+	{0x00 , 0x7B , 0x84 }, // 129
+	{0x00 , 0x78 , 0x87 }, // 130
+	{0x00 , 0x75 , 0x8A }, // 131
+	{0x00 , 0x72 , 0x8D }, // 132
+	{0x00 , 0x6F , 0x90 }, // 133
+	{0x00 , 0x6C , 0x93 }, // 134
+	{0x00 , 0x69 , 0x96 }, // 135
+	{0x00 , 0x66 , 0x99 }, // 136
+	{0x00 , 0x63 , 0x9C }, // 137
+	{0x00 , 0x60 , 0x9F }, // 138
+	{0x00 , 0x5D , 0xA2 }, // 139
+	{0x00 , 0x5A , 0xA5 }, // 140
+	{0x00 , 0x57 , 0xA8 }, // 141
+	{0x00 , 0x54 , 0xAB }, // 142
+	{0x00 , 0x51 , 0xAE }, // 143
+	{0x00 , 0x4E , 0xB1 }, // 144
+	{0x00 , 0x4B , 0xB4 }, // 145
+	{0x00 , 0x48 , 0xB7 }, // 146
+	{0x00 , 0x45 , 0xBA }, // 147
+	{0x00 , 0x42 , 0xBD }, // 148
+	{0x00 , 0x3F , 0xC0 }, // 149
+	{0x00 , 0x3C , 0xC3 }, // 150
+	{0x00 , 0x39 , 0xC6 }, // 151
+	{0x00 , 0x36 , 0xC9 }, // 152
+	{0x00 , 0x33 , 0xCC }, // 153
+	{0x00 , 0x30 , 0xCF }, // 154
+	{0x00 , 0x2D , 0xD2 }, // 155
+	{0x00 , 0x2A , 0xD5 }, // 156
+	{0x00 , 0x27 , 0xD8 }, // 157
+	{0x00 , 0x24 , 0xDB }, // 158
+	{0x00 , 0x21 , 0xDE }, // 159
+	{0x00 , 0x1E , 0xE1 }, // 160
+	{0x00 , 0x1B , 0xE4 }, // 161
+	{0x00 , 0x18 , 0xE7 }, // 162
+	{0x00 , 0x15 , 0xEA }, // 163
+	{0x00 , 0x12 , 0xED }, // 164
+	{0x00 , 0x0F , 0xF0 }, // 165
+	{0x00 , 0x0C , 0xF3 }, // 166
+	{0x00 , 0x09 , 0xF6 }, // 167
+	{0x00 , 0x06 , 0xF9 }, // 168
+	{0x00 , 0x03 , 0xFC }, // 169
+	{0x00 , 0x00 , 0xFF }, // 170
+	{0x03 , 0x00 , 0xFC }, // 171
+	{0x06 , 0x00 , 0xF9 }, // 172
+	{0x09 , 0x00 , 0xF6 }, // 173
+	{0x0C , 0x00 , 0xF3 }, // 174
+	{0x0F , 0x00 , 0xF0 }, // 175
+	{0x12 , 0x00 , 0xED }, // 176
+	{0x15 , 0x00 , 0xEA }, // 177
+	{0x18 , 0x00 , 0xE7 }, // 178
+	{0x1B , 0x00 , 0xE4 }, // 179
+	{0x1E , 0x00 , 0xE1 }, // 180
+	{0x21 , 0x00 , 0xDE }, // 181
+	{0x24 , 0x00 , 0xDB }, // 182
+	{0x27 , 0x00 , 0xD8 }, // 183
+	{0x2A , 0x00 , 0xD5 }, // 184
+	{0x2D , 0x00 , 0xD2 }, // 185
+	{0x30 , 0x00 , 0xCF }, // 186
+	{0x33 , 0x00 , 0xCC }, // 187
+	{0x36 , 0x00 , 0xC9 }, // 188
+	{0x39 , 0x00 , 0xC6 }, // 189
+	{0x3C , 0x00 , 0xC3 }, // 190
+	{0x3F , 0x00 , 0xC0 }, // 191
+	{0x42 , 0x00 , 0xBD }, // 192
+	{0x45 , 0x00 , 0xBA }, // 193
+	{0x48 , 0x00 , 0xB7 }, // 194
+	{0x4B , 0x00 , 0xB4 }, // 195
+	{0x4E , 0x00 , 0xB1 }, // 196
+	{0x51 , 0x00 , 0xAE }, // 197
+	{0x54 , 0x00 , 0xAB }, // 198
+	{0x57 , 0x00 , 0xA8 }, // 199
+	{0x5A , 0x00 , 0xA5 }, // 200
+	{0x5D , 0x00 , 0xA2 }, // 201
+	{0x60 , 0x00 , 0x9F }, // 202
+	{0x63 , 0x00 , 0x9C }, // 203
+	{0x66 , 0x00 , 0x99 }, // 204
+	{0x69 , 0x00 , 0x96 }, // 205
+	{0x6C , 0x00 , 0x93 }, // 206
+	{0x6F , 0x00 , 0x90 }, // 207
+	{0x72 , 0x00 , 0x8D }, // 208
+	{0x75 , 0x00 , 0x8A }, // 209
+	{0x78 , 0x00 , 0x87 }, // 210
+	{0x7B , 0x00 , 0x84 }, // 211
+	{0x7E , 0x00 , 0x81 }, // 212
+	{0x81 , 0x00 , 0x7E }, // 213
+	{0x84 , 0x00 , 0x7B }, // 214
+	{0x87 , 0x00 , 0x78 }, // 215
+	{0x8A , 0x00 , 0x75 }, // 216
+	{0x8D , 0x00 , 0x72 }, // 217
+	{0x90 , 0x00 , 0x6F }, // 218
+	{0x93 , 0x00 , 0x6C }, // 219
+	{0x96 , 0x00 , 0x69 }, // 220
+	{0x99 , 0x00 , 0x66 }, // 221
+	{0x9C , 0x00 , 0x63 }, // 222
+	{0x9F , 0x00 , 0x60 }, // 223
+	{0xA2 , 0x00 , 0x5D }, // 224
+	{0xA5 , 0x00 , 0x5A }, // 225
+	{0xA8 , 0x00 , 0x57 }, // 226
+	{0xAB , 0x00 , 0x54 }, // 227
+	{0xAE , 0x00 , 0x51 }, // 228
+	{0xB1 , 0x00 , 0x4E }, // 229
+	{0xB4 , 0x00 , 0x4B }, // 230
+	{0xB7 , 0x00 , 0x48 }, // 231
+	{0xBA , 0x00 , 0x45 }, // 232
+	{0xBD , 0x00 , 0x42 }, // 233
+	{0xC0 , 0x00 , 0x3F }, // 234
+	{0xC3 , 0x00 , 0x3C }, // 235
+	{0xC6 , 0x00 , 0x39 }, // 236
+	{0xC9 , 0x00 , 0x36 }, // 237
+	{0xCC , 0x00 , 0x33 }, // 238
+	{0xCF , 0x00 , 0x30 }, // 239
+	{0xD2 , 0x00 , 0x2D }, // 240
+	{0xD5 , 0x00 , 0x2A }, // 241
+	{0xD8 , 0x00 , 0x27 }, // 242
+	{0xDB , 0x00 , 0x24 }, // 243
+	{0xDE , 0x00 , 0x21 }, // 244
+	{0xE1 , 0x00 , 0x1E }, // 245
+	{0xE4 , 0x00 , 0x1B }, // 246
+	{0xE7 , 0x00 , 0x18 }, // 247
+	{0xEA , 0x00 , 0x15 }, // 248
+	{0xED , 0x00 , 0x12 }, // 249
+	{0xF0 , 0x00 , 0x0F }, // 250
+	{0xF3 , 0x00 , 0x0C }, // 251
+	{0xF6 , 0x00 , 0x09 }, // 252
+	{0xF9 , 0x00 , 0x06 }, // 253
+	{0xFC , 0x00 , 0x03 }, // 254
+	{0xFF , 0x00 , 0x00 }, // 255
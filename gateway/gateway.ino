@@ -8,6 +8,8 @@
 #include <RFM69.h>         //get it here: https://github.com/LowPowerLab/rfm69
 #include <WirelessHEX69.h> //get it here: https://github.com/LowPowerLab/WirelessProgramming/tree/master/WirelessHEX69
 #include <RingBuffer.h>    //get it here: https://github.com/JorjBauer/RingBuffer
+#include <util/crc16.h>
+#include <RadioSequence.h> // in this repository's libraries/ directory
 
 // Standard RFM69 radio configuration
 #define NODEID        1
@@ -35,8 +37,68 @@
 // Globals
 RFM69 radio;
 
+/* Binary framing. The host opts in by sending the gateway itself (node
+ * 0) a one-byte "B" packet; from then on there's no echo, and every
+ * packet is a frame:
+ *
+ *   host to gateway:  SOF, destNode, id, length, <length bytes>, CRC
+ *   gateway to host:  SOF, type, id, length, <length bytes>, CRC
+ *
+ * The CRC is CRC-16/CCITT (avr-libc's _crc_ccitt_update, starting from
+ * 0xFFFF) over everything between the SOF and the CRC, high byte first.
+ * The gateway answers each host frame with a FRAME_ACK (and the ACK's
+ * data) or FRAME_NAK frame carrying the same id; data the radio hears
+ * otherwise comes up as FRAME_UPLINK. Sending node 0 a "T" goes back to
+ * the text protocol (and 'TO:' programming).
+ *
+ * Frame ids run 1 to 255 and round again, and we only take them in
+ * that order. A frame that fails its CRC is dropped without an answer
+ * (its id can't be trusted), and so is everything after it: each of
+ * those gets a FRAME_RESEND, whose one data byte is the id we want
+ * next. The host goes back and sends again from that one. A "B" to the
+ * gateway is taken whatever its id, and starts the ids over from 1.
+ */
+#define SOF           0xA5
+#define FRAME_HEADER  4 // SOF, destNode/type, id, length
+#define FRAME_CRC     2
+#define FRAME_ACK     'A'
+#define FRAME_NAK     'N'
+#define FRAME_RESEND  'E'
+#define FRAME_UPLINK  'U'
+#define GATEWAY_NODE  0 // destNode for packets to the gateway itself
+bool binaryMode = false;
+byte nextFrameId = 1;
+
+/* Transmit queue, for binary framing. Rather than one blocking
+ * sendWithRetry() at a time, up to TX_WINDOW sequenced packets (see
+ * RadioSequence.h) to one node are in flight at once. Each is resent
+ * every TX_RETRY_WAIT mS until it's ACKed, and only then does the host
+ * get its FRAME_ACK, so the host should have no more than TX_WINDOW
+ * frames outstanding itself. Packets to the gateway, '~~~' magic
+ * packets and anything too big for a sequence header wait for the
+ * queue to empty and then go the old way.
+ */
+#define TX_WINDOW     4   // a power of two
+#define TX_RETRIES    10  // as sendWithRetry() had them
+#define TX_RETRY_WAIT 100 // mS
+struct txSlot {
+  byte frameId;  // host frame to answer
+  byte len;
+  byte tries;
+  unsigned long sentAt;
+  byte data[MAX_PACKET_SIZE]; // sequence header, then the host's data
+};
+txSlot txQueue[TX_WINDOW];
+byte txDest = 0;   // node everything in flight is going to
+byte txOldest = 0; // sequence number of the oldest packet in flight
+byte txNext = 0;   // ... and of the next one to be queued
+bool txNeedSync = true;
+
+#define txSlotFor(seq) (&txQueue[(seq) & (TX_WINDOW-1)])
+#define txInFlight() ((byte)(txNext - txOldest))
+
 // Buffers
-RingBuffer stashedSerialData(MAX_PACKET_SIZE+2); // ... +2 for a destination node and packet length
+RingBuffer stashedSerialData(MAX_PACKET_SIZE+FRAME_HEADER+FRAME_CRC); // big enough for a whole binary frame; text packets need +2
 byte radioBuffer[MAX_PACKET_SIZE];               // Linear buffer, used to prepare packets for sending
 int radioBufferPtr = 0;
 
@@ -117,12 +179,217 @@ void wirelessProgrammingMode()
   }
 }
 
+void sendFrame(byte type, byte id, const volatile byte *d, byte len)
+{
+  byte header[3] = { type, id, len };
+  uint16_t crc = 0xFFFF;
+
+  Serial.write(SOF);
+  for (byte i=0; i<sizeof(header); i++) {
+    Serial.write(header[i]);
+    crc = _crc_ccitt_update(crc, header[i]);
+  }
+  for (byte i=0; i<len; i++) {
+    Serial.write(d[i]);
+    crc = _crc_ccitt_update(crc, d[i]);
+  }
+  Serial.write(crc >> 8);
+  Serial.write(crc & 0xFF);
+}
+
+// A packet addressed to the gateway itself; returns true if we understood it
+bool handleGatewayPacket(const byte *d, byte len)
+{
+  if (len != 1)
+    return false;
+
+  if (d[0] == 'B') {
+    binaryMode = true;
+    nextFrameId = 1;
+    return true;
+  } else if (d[0] == 'T') {
+    binaryMode = false;
+    return true;
+  }
+  return false;
+}
+
+bool canQueue(byte destNode)
+{
+  if (!txInFlight())
+    return true;
+  if (destNode != txDest || txInFlight() == TX_WINDOW)
+    return false;
+  // Nothing more goes until the receiver has taken a sync packet
+  return txSlotFor(txOldest)->data[0] != SEQ_SYNC;
+}
+
+void queuePacket(byte destNode, byte frameId, const byte *d, byte len)
+{
+  if (destNode != txDest) {
+    txDest = destNode;
+    txNeedSync = true;
+  }
+
+  txSlot *s = txSlotFor(txNext);
+  s->data[0] = txNeedSync ? SEQ_SYNC : SEQ_MARK;
+  s->data[1] = txNext;
+  memcpy(&s->data[SEQ_HEADER], d, len);
+  s->len = SEQ_HEADER + len;
+  s->frameId = frameId;
+  s->tries = 0;
+
+  txNext++;
+  txNeedSync = false;
+  // sent on the next serviceTxQueue()
+}
+
+// A packet never got through. The receiver won't take anything after
+// it, so none of the rest will either: fail them all and sync again.
+void abandonTxQueue()
+{
+  for (; txOldest != txNext; txOldest++) {
+    sendFrame(FRAME_NAK, txSlotFor(txOldest)->frameId, NULL, 0);
+  }
+  txNeedSync = true;
+}
+
+void serviceTxQueue()
+{
+  for (byte seq = txOldest; seq != txNext; seq++) {
+    txSlot *s = txSlotFor(seq);
+    if (s->tries && millis() - s->sentAt < TX_RETRY_WAIT)
+      continue;
+
+    if (s->tries > TX_RETRIES) {
+      abandonTxQueue();
+      return;
+    }
+    radio.send(txDest, s->data, s->len, true);
+    s->sentAt = millis();
+    s->tries++;
+  }
+}
+
+// The receiver has been reset, and lost track of where we are: send
+// everything in flight again, starting with a sync
+void resyncTxQueue()
+{
+  txSlot *oldest = txSlotFor(txOldest);
+  if (oldest->data[0] == SEQ_SYNC)
+    return; // already on its way
+
+  oldest->data[0] = SEQ_SYNC;
+  for (byte seq = txOldest; seq != txNext; seq++) {
+    txSlotFor(seq)->tries = 0;
+  }
+}
+
+// An ACK from the radio; it covers everything up to the sequence number in it
+void handleTxAck()
+{
+  if (radio.SENDERID != txDest || radio.DATALEN != SEQ_HEADER || !txInFlight())
+    return;
+  if (radio.DATA[0] == SEQ_SYNC) {
+    resyncTxQueue();
+    return;
+  }
+  if (radio.DATA[0] != SEQ_MARK)
+    return;
+
+  byte acked = (byte)(radio.DATA[1] - txOldest) + 1;
+  if (acked > txInFlight())
+    return; // a repeat of one we've already had
+
+  while (acked--) {
+    sendFrame(FRAME_ACK, txSlotFor(txOldest)->frameId, NULL, 0);
+    txOldest++;
+  }
+}
+
+void handleBinaryFrame()
+{
+  // Skip anything that isn't the start of a frame
+  while (stashedSerialData.hasData() && stashedSerialData.peek(0) != SOF) {
+    stashedSerialData.consumeByte();
+  }
+
+  int count = stashedSerialData.count();
+  if (count < FRAME_HEADER)
+    return;
+
+  byte id = stashedSerialData.peek(2);
+  byte len = stashedSerialData.peek(3);
+  if (len > MAX_PACKET_SIZE) {
+    // Can't be a real frame; look for the next SOF
+    stashedSerialData.consumeByte();
+    return;
+  }
+  if (count < FRAME_HEADER + len + FRAME_CRC)
+    return;
+
+  uint16_t crc = 0xFFFF;
+  for (byte i=1; i<FRAME_HEADER + len; i++) {
+    crc = _crc_ccitt_update(crc, stashedSerialData.peek(i));
+  }
+  uint16_t sentCrc = (stashedSerialData.peek(FRAME_HEADER + len) << 8) | stashedSerialData.peek(FRAME_HEADER + len + 1);
+  if (crc != sentCrc) {
+    // Drop just the SOF, in case the real frame starts inside this one
+    stashedSerialData.consumeByte();
+    return;
+  }
+
+  byte destNode = stashedSerialData.peek(1);
+  bool restart = (destNode == GATEWAY_NODE && len == 1 && stashedSerialData.peek(FRAME_HEADER) == 'B');
+  if (id != nextFrameId && !restart) {
+    // After one we lost; the host will send it all again
+    for (byte i=0; i<FRAME_HEADER + len + FRAME_CRC; i++) {
+      stashedSerialData.consumeByte();
+    }
+    sendFrame(FRAME_RESEND, id, &nextFrameId, 1);
+    return;
+  }
+
+  bool sequenced = (destNode != GATEWAY_NODE && len <= MAX_PACKET_SIZE - SEQ_HEADER &&
+                    !(len >= 3 && stashedSerialData.peek(FRAME_HEADER) == '~' &&
+                      stashedSerialData.peek(FRAME_HEADER+1) == '~' &&
+                      stashedSerialData.peek(FRAME_HEADER+2) == '~'));
+  if (sequenced ? !canQueue(destNode) : txInFlight() != 0)
+    return; // leave it until there's room
+
+  stashedSerialData.consumeByte(); // SOF
+  stashedSerialData.consumeByte(); // destNode
+  stashedSerialData.consumeByte(); // id
+  stashedSerialData.consumeByte(); // length
+  for (radioBufferPtr = 0; radioBufferPtr < len; radioBufferPtr++) {
+    radioBuffer[radioBufferPtr] = stashedSerialData.consumeByte();
+  }
+  stashedSerialData.consumeByte(); // CRC
+  stashedSerialData.consumeByte();
+  nextFrameId = (id % 255) + 1;
+
+  if (destNode == GATEWAY_NODE) {
+    sendFrame(handleGatewayPacket(radioBuffer, len) ? FRAME_ACK : FRAME_NAK, id, NULL, 0);
+  } else if (sequenced) {
+    queuePacket(destNode, id, radioBuffer, len);
+  } else if (radio.sendWithRetry(destNode, radioBuffer, len, 10, 100)) { // 10 retry attempts, 100mS between
+    sendFrame(FRAME_ACK, id, radio.DATA, radio.DATALEN);
+  } else {
+    sendFrame(FRAME_NAK, id, NULL, 0);
+  }
+}
+
 void loop() {
   // if data is incoming on the software serial side, then read it for later processing.
-  if (Serial.available()) {
+  // Binary frames are read as fast as they come; text a byte per pass, so
+  // that a 'TO:' is spotted before we read past it.
+  while (Serial.available() && !stashedSerialData.isFull()) {
     byte b = Serial.read();
     stashedSerialData.addByte(b);
 
+    if (binaryMode)
+      continue; // no echo
+
     /* If we are in the first two bytes and it's a "TO", then we don't
      * echo those immediately. That means that we can't address node
      * 84 ("T"). So, as a short cut, we won't echo the characters back
@@ -133,6 +400,7 @@ void loop() {
     if (stashedSerialData.peek(0) != 'T') {
       Serial.write(b);
     }
+    break;
   }
 
   /* If there's data on the radio, then send that out the serial port
@@ -141,10 +409,22 @@ void loop() {
    */
 
   if (radio.receiveDone()){
-    for (int i=0; i<radio.DATALEN; i++) {
-      Serial.write(radio.DATA[i]);
+    if (binaryMode && radio.ACK_RECEIVED) {
+      handleTxAck();
+    } else if (binaryMode) {
+      sendFrame(FRAME_UPLINK, 0, radio.DATA, radio.DATALEN);
+    } else {
+      for (int i=0; i<radio.DATALEN; i++) {
+        Serial.write(radio.DATA[i]);
+      }
     }
   }
+
+  if (binaryMode) {
+    handleBinaryFrame();
+    serviceTxQueue();
+    return;
+  }
     
   /* If there's software serial data to send, then send it on the radio.
    * Serial data incoming is expected to be in a particular form:
@@ -195,7 +475,15 @@ void loop() {
         packetsize--;
       }
 
-      if (radio.sendWithRetry(destNode, radioBuffer, radioBufferPtr, 10, 100)) { // 10 retry attempts, 100mS between
+      if (destNode == GATEWAY_NODE) {
+        // For us, not the radio (e.g. switching to binary framing)
+        if (handleGatewayPacket(radioBuffer, radioBufferPtr)) {
+          Serial.print("ACK");
+          Serial.write(0);
+        } else {
+          Serial.print("NAK");
+        }
+      } else if (radio.sendWithRetry(destNode, radioBuffer, radioBufferPtr, 10, 100)) { // 10 retry attempts, 100mS between
       	/* If we get an ACK, we'll return (to the caller, via the
 	 * serial port) the data that was in the ACK:
 	 *
@@ -0,0 +1,283 @@
+/*
+ * Host-side frame-cost benchmark for the driver.
+ *
+ * The sketch is compiled directly in to this file, against the shims in
+ * host/shims, so that each mode can be driven exactly the way loop()
+ * drives it on the Pro Mini. Time is simulated (1mS per loop() pass);
+ * only the wall-clock cost of each pass is real.
+ *
+ * For each mode we report:
+ *   frames      - how many times the mode's callback ran
+ *   ns/frame    - mean cost of a loop() pass that ran the callback
+ *   ns/idle     - mean cost of a loop() pass that only faded
+ *   set/frame,
+ *   get/frame   - strip setPixelColor()/getPixelColor() calls per frame
+ *   shows       - strip.show() calls over the whole run
+ *   skipped     - frames not latched because nothing actually changed
+ *
+ * The "L x8" and "P+F" rows are serial command handling rather than
+ * modes: frames is the number of loop() passes it took to consume the
+ * commands for one whole display, sent all at once.
+ */
+
+#include "../driver/driver.ino"
+
+#include <chrono>
+#include <vector>
+
+#define SIMULATED_MS 20000
+
+struct BenchCase {
+  const char *name;
+  runmode mode;
+  const char *command;  // serial command that selects the mode
+  uint8_t commandLength;
+  const char *text;     // text fed to text mode, if any
+};
+
+static const BenchCase cases[] = {
+  { "twinkle",      TwinkleMode,      "T",                       1,  NULL },
+  { "wipe",         WipeMode,         "W\xFF\x40\x00",           4,  NULL },
+  { "rings",        RingsMode,        "R\x7F\x00\x40\xFF\x01",   6,  NULL },
+  { "text",         TextMode,         "t",                       1,  "Purposeless LED display 0123456789" },
+  { "matrix",       MatrixMode,       "M12:34\xFF\xFF\xFF\x00\x0A\x04", 12, NULL },
+  { "theaterChase", TheaterChaseMode, "@",                       1,  NULL },
+  { "rainbow",      RainbowMode,      "~",                       1,  NULL },
+  { "tardis",       TardisMode,       "|",                       1,  NULL },
+  { "life",         LifeMode,         "l",                       1,  NULL },
+  { "rotate",       RotateMode,       "$",                       1,  NULL },
+  { "animation",    AnimationMode,    "A\x10",                  2,  NULL },
+  // Last, since brightness and gamma stay set: rainbow through the output stage
+  { "rainbowGamma", RainbowMode,      "B\x80G\x01~",           5,  NULL },
+};
+
+static uint64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Run loop() until everything queued on the serial port has been consumed.
+static void drainSerial()
+{
+  while (Serial.hostPendingInput()) {
+    hostAdvanceMillis(1);
+    loop();
+  }
+}
+
+static void enterRawMode()
+{
+  // Two NULs leave text mode; 'r' puts us in raw mode from anywhere else.
+  Serial.hostInject((const uint8_t *)"\0\0r", 3);
+  drainSerial();
+}
+
+static void runCase(const BenchCase *c)
+{
+  enterRawMode();
+
+  // Give rotate something to rotate.
+  if (c->mode == RotateMode) {
+    for (int i=0; i<TOTAL_LEDS; i++) {
+      strip.setPixelColor(i, Wheel(i));
+    }
+  }
+
+  // ... and animation something to play: 16 frames, 40mS apart
+  if (c->mode == AnimationMode) {
+    for (int f=0; f<16; f++) {
+      for (int i=0; i<TOTAL_LEDS; i++) {
+        strip.setPixelColor(i, Wheel(i + f * 16));
+      }
+      uint8_t store[] = { 'S', (uint8_t)f, 0, 40 };
+      Serial.hostInject(store, sizeof(store));
+      drainSerial();
+    }
+  }
+
+  Serial.hostInject((const uint8_t *)c->command, c->commandLength);
+  drainSerial();
+  if (c->text) {
+    Serial.hostInject((const uint8_t *)c->text, strlen(c->text));
+  }
+
+  strip.resetCounters();
+  unsigned long skippedBefore = framesSkipped;
+
+  unsigned long frames = 0, idles = 0;
+  unsigned long frameSets = 0, frameGets = 0;
+  uint64_t frameNs = 0, idleNs = 0;
+
+  for (unsigned long ms = 0; ms < SIMULATED_MS; ms++) {
+    hostAdvanceMillis(1);
+
+    unsigned long lastNext = next_millis;
+    runmode lastMode = current_mode;
+    unsigned long sets = strip.setPixelColorCalls;
+    unsigned long gets = strip.getPixelColorCalls;
+
+    uint64_t start = nowNs();
+    loop();
+    uint64_t elapsed = nowNs() - start;
+
+    // The callback ran if it rescheduled itself (or ended the mode).
+    if (next_millis != lastNext || current_mode != lastMode) {
+      frames++;
+      frameNs += elapsed;
+      frameSets += strip.setPixelColorCalls - sets;
+      frameGets += strip.getPixelColorCalls - gets;
+    } else {
+      idles++;
+      idleNs += elapsed;
+    }
+  }
+
+  printf("%-14s %7lu %10.0f %9.0f %10.1f %10.1f %7lu %8lu\n",
+         c->name,
+         frames,
+         frames ? (double)frameNs / frames : 0.0,
+         idles ? (double)idleNs / idles : 0.0,
+         frames ? (double)frameSets / frames : 0.0,
+         frames ? (double)frameGets / frames : 0.0,
+         strip.showCalls,
+         framesSkipped - skippedBefore);
+}
+
+// Fader::performFade() on its own: every pixel fading from full white to black.
+static void runFaderCase()
+{
+  enterRawMode();
+
+  for (int i=0; i<TOTAL_LEDS; i++) {
+    fader->stopFading(i);
+    strip.setPixelColor(i, 0xFFFFFF);
+    fader->setFadeTarget(i, 0);
+  }
+  strip.resetCounters();
+
+  unsigned long passes = 0, idles = 0;
+  uint64_t ns = 0, idleNs = 0;
+  bool fading = true;
+  while (fading && passes + idles < 100000) {
+    hostAdvanceMillis(1);
+    uint64_t start = nowNs();
+    bool changed = fader->performFade();
+    uint64_t elapsed = nowNs() - start;
+    if (changed) {
+      passes++;
+      ns += elapsed;
+    } else {
+      idles++;
+      idleNs += elapsed;
+    }
+
+    fading = false;
+    for (int i=0; i<TOTAL_LEDS && !fading; i++) {
+      fading = fader->isFading(i);
+    }
+  }
+
+  printf("%-14s %7lu %10.0f %9.0f %10.1f %10.1f %7s %8s\n",
+         "performFade",
+         passes,
+         passes ? (double)ns / passes : 0.0,
+         idles ? (double)idleNs / idles : 0.0,
+         passes ? (double)strip.setPixelColorCalls / passes : 0.0,
+         passes ? (double)strip.getPixelColorCalls / passes : 0.0,
+         "-", "-");
+}
+
+// Serial command handling: how many loop() passes, and how long, until
+// a burst of commands arriving at once has been handled
+static void runCommandCase(const char *name, const std::vector<uint8_t> &commands)
+{
+  enterRawMode();
+
+  Serial.hostInject(commands.data(), commands.size());
+  strip.resetCounters();
+
+  unsigned long passes = 0;
+  uint64_t ns = 0;
+  while (Serial.hostPendingInput()) {
+    hostAdvanceMillis(1);
+    uint64_t start = nowNs();
+    loop();
+    ns += nowNs() - start;
+    passes++;
+  }
+
+  printf("%-14s %7lu %10.0f %9s %10.1f %10.1f %7lu %8s   (%zu bytes)\n",
+         name,
+         passes,
+         (double)ns / passes,
+         "-",
+         (double)strip.setPixelColorCalls / passes,
+         (double)strip.getPixelColorCalls / passes,
+         strip.showCalls,
+         "-",
+         commands.size());
+}
+
+// A whole display of 565 pixels as eight 'L' commands
+static std::vector<uint8_t> ringCommands()
+{
+  std::vector<uint8_t> v;
+  for (int y=0; y<NUM_RINGS; y++) {
+    v.push_back('L');
+    v.push_back('0' + y);
+    for (int i=0; i<RINGBYTES - 1; i++) {
+      v.push_back((i * 37 + y) & 0xFF);
+    }
+  }
+  return v;
+}
+
+// A 16-color palette, then a frame of 12-pixel bands as 'F' run bytes
+static std::vector<uint8_t> paletteFrameCommands()
+{
+  std::vector<uint8_t> v = { 'P', 1 + 2 * PALETTE_SIZE, 0 };
+  for (int i=0; i<PALETTE_SIZE; i++) {
+    uint16_t c = i * 0x1083;
+    v.push_back(c >> 8);
+    v.push_back(c & 0xFF);
+  }
+
+  std::vector<uint8_t> runs;
+  for (int p=0; p<TOTAL_LEDS; p+=12) {
+    runs.push_back((11 << 4) | ((p / 12) & 0x0F));
+  }
+  v.push_back('F');
+  v.push_back(1 + runs.size());
+  v.push_back(FRAME_FIRST); // flags: this is the whole frame
+  v.insert(v.end(), runs.begin(), runs.end());
+  return v;
+}
+
+int main(int argc, char **argv)
+{
+  const char *only = (argc > 1) ? argv[1] : NULL;
+
+  randomSeed(1);
+  setup();
+
+  printf("%-14s %7s %10s %9s %10s %10s %7s %8s\n",
+         "mode", "frames", "ns/frame", "ns/idle", "set/frame", "get/frame", "shows", "skipped");
+
+  for (size_t i=0; i<sizeof(cases)/sizeof(cases[0]); i++) {
+    if (only && strcmp(only, cases[i].name))
+      continue;
+    runCase(&cases[i]);
+  }
+  if (!only || !strcmp(only, "performFade")) {
+    runFaderCase();
+  }
+  if (!only || !strcmp(only, "L")) {
+    runCommandCase("L x8", ringCommands());
+  }
+  if (!only || !strcmp(only, "F")) {
+    runCommandCase("P+F", paletteFrameCommands());
+  }
+
+  return 0;
+}
@@ -0,0 +1,64 @@
+#!/usr/bin/perl
+
+# Writes the raw commands Display.pm sends for a palette and a few frames,
+# for driver_test to feed to the driver. Output is the 16 palette entries
+# (RGB565, high byte first), then for each step: a 2-byte length, that
+# many bytes of commands, and the 192 palette indexes the display should
+# show once they've been handled.
+
+use strict;
+use warnings;
+use FindBin;
+use lib "$FindBin::Bin/../supporting";
+
+# Nothing here talks to a real port
+BEGIN { $INC{'Device/SerialPort.pm'} = __FILE__; }
+use Display;
+
+my $commands = '';
+{
+    no warnings 'redefine';
+    *Display::sendCommand = sub { $commands .= $_[1]; };
+    *Display::queueCommand = sub { $commands .= $_[1]; };
+}
+
+binmode(STDOUT);
+
+my $d = bless({}, 'Display');
+
+my @colors = map { [ ($_ * 17) & 0xFF, (255 - $_ * 13) & 0xFF, ($_ * 71) & 0xFF ] } (0..15);
+foreach my $c (@colors) {
+    my ($r, $g, $b) = @$c;
+    print pack('n', (($r & 0xF8) << 8) | (($g & 0xFC) << 3) | ($b >> 3));
+}
+
+sub step {
+    my ($pixels) = @_;
+    print pack('n', length($commands)), $commands, join('', map { chr } @$pixels);
+    $commands = '';
+}
+
+# Random pixels don't run-length encode, so this takes several 'F' chunks
+srand(1);
+my @pixels = map { int(rand(16)) } (1..Display::TOTAL_LEDS);
+$d->palette(@colors);
+$d->frame(\@pixels);
+step(\@pixels);
+
+# A frame of long runs fits in one
+@pixels = map { int($_ / 20) } (0..Display::TOTAL_LEDS-1);
+$d->frame(\@pixels);
+step(\@pixels);
+
+# A couple of pixels changed: one small 'D'
+$pixels[0] = 15;
+$pixels[150] = 14;
+$d->deltaFrame(\@pixels);
+step(\@pixels);
+
+# Every third pixel changed: several 'D' chunks
+for (my $i = 1; $i < @pixels; $i += 3) {
+    $pixels[$i] = ($pixels[$i] + 7) % 16;
+}
+$d->deltaFrame(\@pixels);
+step(\@pixels);
@@ -0,0 +1,120 @@
+/*
+ * Feeds the driver the palette and frame commands Display.pm sends
+ * (written out by display_frames.pl, so this has to be run from host/)
+ * and checks the display shows what the script asked for, whether the
+ * frame went as one 'F'/'D' command or was split over several.
+ *
+ * Also checks a stray 'P' with a length byte of 0xFF is dropped rather
+ * than run: 1 + 0xFF wraps to 0 in a byte, which once let it through
+ * to read palette entries that never arrived.
+ */
+
+#include "../driver/driver.ino"
+
+#include <stdio.h>
+#include <vector>
+
+static std::vector<uint8_t> script;
+static size_t scriptPos;
+
+static void drainSerial()
+{
+  while (Serial.hostPendingInput()) {
+    hostAdvanceMillis(1);
+    loop();
+  }
+}
+
+static bool readScript()
+{
+  FILE *f = popen("perl display_frames.pl", "r");
+  if (!f)
+    return false;
+  int c;
+  while ((c = fgetc(f)) != EOF)
+    script.push_back(c);
+  return pclose(f) == 0 && script.size() > PALETTE_SIZE * 2;
+}
+
+static bool checkPalette()
+{
+  for (int i=0; i<PALETTE_SIZE; i++) {
+    uint16_t c = (script[i*2] << 8) | script[i*2+1];
+    if (palette[i] != c) {
+      printf("FAIL: palette entry %d is %04x, not %04x\n", i, palette[i], c);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool checkPixels(const uint8_t *indexes, const char *what)
+{
+  for (int i=0; i<TOTAL_LEDS; i++) {
+    uint16_t c = (script[indexes[i]*2] << 8) | script[indexes[i]*2+1];
+    if (strip.getPixelColor(i) != un565(c)) {
+      printf("FAIL: %s: pixel %d is %06x, not index %d (%06x)\n",
+             what, i, strip.getPixelColor(i), indexes[i], un565(c));
+      return false;
+    }
+  }
+  return true;
+}
+
+// Send one step's commands; returns its expected indexes, or NULL at the end
+static const uint8_t *runStep()
+{
+  if (scriptPos + 2 > script.size())
+    return NULL;
+  size_t len = (script[scriptPos] << 8) | script[scriptPos+1];
+  scriptPos += 2;
+  if (scriptPos + len + TOTAL_LEDS > script.size())
+    return NULL;
+
+  Serial.hostInject(&script[scriptPos], len);
+  drainSerial();
+  scriptPos += len;
+
+  const uint8_t *indexes = &script[scriptPos];
+  scriptPos += TOTAL_LEDS;
+  return indexes;
+}
+
+int main()
+{
+  if (!readScript()) {
+    printf("FAIL: couldn't run display_frames.pl\n");
+    return 1;
+  }
+  scriptPos = PALETTE_SIZE * 2;
+
+  randomSeed(1);
+  setup();
+  Serial.hostInject((const uint8_t *)"\0\0r", 3);
+  drainSerial();
+
+  int steps = 0;
+  const uint8_t *indexes = runStep();
+  if (!indexes || !checkPalette() || !checkPixels(indexes, "first frame"))
+    return 1;
+  steps++;
+
+  Serial.hostInject((const uint8_t *)"P\xFF", 2);
+  drainSerial();
+  if (!checkPalette() || !checkPixels(indexes, "after 'P' 0xFF"))
+    return 1;
+  printf("'P' 0xFF: dropped\n");
+
+  while ((indexes = runStep())) {
+    char what[16];
+    snprintf(what, sizeof(what), "step %d", ++steps);
+    if (!checkPixels(indexes, what))
+      return 1;
+  }
+  if (scriptPos != script.size()) {
+    printf("FAIL: display_frames.pl output is truncated\n");
+    return 1;
+  }
+  printf("%d frames from Display.pm shown as sent\n", steps);
+  return 0;
+}
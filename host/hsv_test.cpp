@@ -0,0 +1,149 @@
+/*
+ * Checks hsv_to_rgb8() against the double-precision hsv_to_rgb() the
+ * sketches used to carry, for every h/s/v, and times the two.
+ *
+ * The timings are host timings: an x86 FPU makes the double version
+ * look cheap. On the AVR (where double is a 32-bit float) every one of
+ * its arithmetic operations, comparisons and conversions between float
+ * and int is a soft-float library call, so we also count those: the old
+ * version is run once more on a float that tallies what it does. The
+ * integer version makes none.
+ */
+
+#include <HSV.h>
+
+#include <chrono>
+
+// Soft-float library calls an AVR build would make (__addsf3,
+// __mulsf3, __ltsf2, __floatsisf, __fixunssfsi and so on)
+struct SoftFloatCalls {
+  unsigned long addSub, mul, div, compare, convert;
+};
+static SoftFloatCalls calls;
+
+// A float that counts them. Constants are folded by the compiler, so
+// building one from a double costs nothing; an int at run time is a
+// __floatsisf.
+struct SoftFloat {
+  float f;
+
+  SoftFloat() : f(0) {}
+  SoftFloat(double d) : f(d) {}
+  explicit SoftFloat(int i) : f(i) { calls.convert++; }
+  explicit operator int() const { calls.convert++; return (int)f; }
+
+  friend SoftFloat operator+(SoftFloat a, SoftFloat b) { calls.addSub++; return SoftFloat(a.f + b.f); }
+  friend SoftFloat operator-(SoftFloat a, SoftFloat b) { calls.addSub++; return SoftFloat(a.f - b.f); }
+  friend SoftFloat operator*(SoftFloat a, SoftFloat b) { calls.mul++; return SoftFloat(a.f * b.f); }
+  friend SoftFloat operator/(SoftFloat a, SoftFloat b) { calls.div++; return SoftFloat(a.f / b.f); }
+  friend bool operator<(SoftFloat a, SoftFloat b) { calls.compare++; return a.f < b.f; }
+  friend bool operator>(SoftFloat a, SoftFloat b) { calls.compare++; return a.f > b.f; }
+};
+
+// The original, from driver.ino and receiver.ino; Real is double but
+// for counting. The conversions between int and Real that it did
+// implicitly are spelled out.
+template <typename Real>
+static void
+hsv_to_rgb (int h, Real s, Real v,
+            uint8_t *r, uint8_t *g, uint8_t *b)
+{
+  Real H, S, V, R, G, B;
+  Real p1, p2, p3;
+  Real f;
+  int i;
+
+  if (s < 0) s = 0;
+  if (v < 0) v = 0;
+  if (s > 1) s = 1;
+  if (v > 1) v = 1;
+  S = s; V = v;
+  H = Real(h % 360) / 60.0;
+  i = (int)H;
+  f = H - Real(i);
+  p1 = V * (1 - S);
+  p2 = V * (1 - (S * f));
+  p3 = V * (1 - (S * (1 - f)));
+  if      (i == 0) { R = V;  G = p3; B = p1; }
+  else if (i == 1) { R = p2; G = V;  B = p1; }
+  else if (i == 2) { R = p1; G = V;  B = p3; }
+  else if (i == 3) { R = p1; G = p2; B = V;  }
+  else if (i == 4) { R = p3; G = p1; B = V;  }
+  else             { R = V;  G = p1; B = p2; }
+  *r = (int)(R * 255);
+  *g = (int)(G * 255);
+  *b = (int)(B * 255);
+}
+
+static uint64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main()
+{
+  int worst = 0;
+  unsigned long failures = 0;
+
+  for (int h=0; h<720; h++) {
+    for (int s=0; s<256; s++) {
+      for (int v=0; v<256; v++) {
+        uint8_t expected[3], actual[3];
+        hsv_to_rgb<double>(h, s / 255.0, v / 255.0, &expected[0], &expected[1], &expected[2]);
+        hsv_to_rgb8(h, s, v, &actual[0], &actual[1], &actual[2]);
+        for (int c=0; c<3; c++) {
+          int d = abs(expected[c] - actual[c]);
+          if (d > worst)
+            worst = d;
+          if (d > 1) {
+            if (failures < 10) {
+              printf("FAIL: h %d s %d v %d channel %d: expected %d, got %d\n",
+                     h, s, v, c, expected[c], actual[c]);
+            }
+            failures++;
+          }
+        }
+      }
+    }
+  }
+  printf("hsv_to_rgb8: worst channel difference %d over %d conversions\n",
+         worst, 720 * 256 * 256);
+
+  // Timing; the sums keep the compiler from discarding the work
+  unsigned long sum = 0;
+  uint8_t r, g, b;
+  uint64_t start = nowNs();
+  for (int h=0; h<360; h++) {
+    for (int v=0; v<256; v++) {
+      hsv_to_rgb<double>(h, 1.0, v / 256.0, &r, &g, &b);
+      sum += r + g + b;
+    }
+  }
+  uint64_t doubleNs = nowNs() - start;
+
+  start = nowNs();
+  for (int h=0; h<360; h++) {
+    for (int v=0; v<256; v++) {
+      hsv_to_rgb8(h, 255, v, &r, &g, &b);
+      sum += r + g + b;
+    }
+  }
+  uint64_t intNs = nowNs() - start;
+
+  printf("hsv_to_rgb (double): %.1f ns/call\n", (double)doubleNs / (360 * 256));
+  printf("hsv_to_rgb8:         %.1f ns/call   (checksum %lu)\n", (double)intNs / (360 * 256), sum);
+
+  memset(&calls, 0, sizeof(calls));
+  for (int h=0; h<360; h++) {
+    for (int v=0; v<256; v++) {
+      hsv_to_rgb<SoftFloat>(h, 1.0, v / 256.0, &r, &g, &b);
+    }
+  }
+  const double n = 360 * 256;
+  unsigned long total = calls.addSub + calls.mul + calls.div + calls.compare + calls.convert;
+  printf("AVR soft-float calls per hsv_to_rgb: %.1f (add/sub %.1f, mul %.1f, div %.1f, compare %.1f, convert %.1f); hsv_to_rgb8: 0\n",
+         total / n, calls.addSub / n, calls.mul / n, calls.div / n, calls.compare / n, calls.convert / n);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,404 @@
+/*
+ * Host-side cycle-count benchmark for the receiver's bit-banged ISP
+ * programmer (receiver/bbspi.h and Programmer.cpp).
+ *
+ * The pins are wired to a model of an ATmega328P in serial programming
+ * mode, which samples MOSI on SCK's rising edge and shifts MISO out on
+ * the falling edge. If SCK was high or low for fewer than minPhase
+ * cycles, the bit it samples is wrong, as a real target's would be.
+ * Page writes and erases keep it busy (ignoring everything but RDY/BSY
+ * polls) for as long as the datasheet says they take.
+ * Cycles are counted by the pin shims (see Arduino.h).
+ *
+ * We report, for each way of driving the pins:
+ *   cyc/byte   - CPU cycles per byte transferred
+ *   kHz        - the SCK rate that works out to
+ *   min phase  - shortest time SCK was high or low, in cycles
+ *   errors     - signature reads that came back wrong
+ * then the time to erase and program an image through Programmer (with
+ * its delays), how many pages it wrote, the SCK rate it measured, how
+ * long reading it back for a CRC took, and whether both the target's
+ * flash and that CRC match the image. The last case is a target that can't keep up with the
+ * fast path, so the programmer has to fall back to the slow clock.
+ * Then targets that never finish a page write or an erase: programming
+ * should stop there with PS_WriteFailed, after how long.
+ * Finally, how long hashing the image's pages (for a delta update)
+ * takes, and whether every hash matches the image's.
+ */
+
+#include "Programmer.h"
+
+#include <util/crc16.h>
+#include <vector>
+
+#define PIN_RST  4
+#define PIN_MOSI 15
+#define PIN_MISO 16
+#define PIN_SCK  17
+
+#define SPI_CLOCK (1000000/6) // as in Programmer.cpp
+
+#define FLASH_WORDS 16384
+#define PAGE_WORDS  64
+
+static const uint8_t signature[3] = { 0x1E, 0x95, 0x0F };
+
+struct IspTarget {
+  unsigned long minPhase;
+  unsigned long long lastEdge;
+  unsigned long shortestPhase;
+  bool enabled;
+  unsigned long long busyUntil; // a write or erase in progress
+  bool stuckWriting, stuckErasing; // never comes ready after one
+  unsigned long pageWrites;
+  uint8_t in, out, bits, index;
+  uint8_t instr[4];
+  uint8_t highFuse, lowFuse;
+  uint16_t pageBuffer[PAGE_WORDS];
+  uint16_t flash[FLASH_WORDS];
+};
+
+static IspTarget target;
+
+static uint8_t targetRead(const uint8_t *i)
+{
+  switch (i[0]) {
+  case 0x30:
+    return (i[2] & 3) < 3 ? signature[i[2] & 3] : 0;
+  case 0x50:
+    return i[1] == 0x00 ? target.lowFuse : 0xFF;
+  case 0x58:
+    return target.highFuse;
+  case 0x20:
+    return target.flash[((i[1] << 8) | i[2]) % FLASH_WORDS] & 0xFF;
+  case 0x28:
+    return target.flash[((i[1] << 8) | i[2]) % FLASH_WORDS] >> 8;
+  case 0xF0:
+    return hostCycles() < target.busyUntil ? 1 : 0;
+  }
+  return 0;
+}
+
+// How long the 328P takes to write a page or fuse, and to erase
+#define WRITE_CYCLES (F_CPU / 1000 * 45 / 10) // 4.5mS
+#define ERASE_CYCLES (F_CPU / 1000 * 9)       // 9mS
+
+static void targetExecute(const uint8_t *i)
+{
+  if (i[0] == 0xAC && i[1] == 0x53) {
+    target.enabled = true;
+    return;
+  }
+  // Until a write or erase is done, only polling RDY/BSY works
+  if (!target.enabled || hostCycles() < target.busyUntil)
+    return;
+
+  uint16_t *w = &target.pageBuffer[i[2] & (PAGE_WORDS-1)];
+  switch (i[0]) {
+  case 0x40:
+    *w = (*w & 0xFF00) | i[3];
+    break;
+  case 0x48:
+    *w = (*w & 0x00FF) | (i[3] << 8);
+    break;
+  case 0x4C:
+    {
+      // Programming can only clear bits
+      uint16_t page = ((i[1] << 8) | i[2]) & ~(PAGE_WORDS-1);
+      for (int n=0; n<PAGE_WORDS; n++) {
+        target.flash[(page + n) % FLASH_WORDS] &= target.pageBuffer[n];
+        target.pageBuffer[n] = 0xFFFF;
+      }
+      target.busyUntil = target.stuckWriting ? ~0ULL : hostCycles() + WRITE_CYCLES;
+      target.pageWrites++;
+    }
+    break;
+  case 0xAC:
+    if (i[1] == 0x80) {
+      for (int n=0; n<FLASH_WORDS; n++)
+        target.flash[n] = 0xFFFF;
+      target.busyUntil = target.stuckErasing ? ~0ULL : hostCycles() + ERASE_CYCLES;
+    } else if (i[1] == 0xA8) {
+      target.highFuse = i[3];
+      target.busyUntil = hostCycles() + WRITE_CYCLES;
+    } else if (i[1] == 0xA0) {
+      target.lowFuse = i[3];
+      target.busyUntil = hostCycles() + WRITE_CYCLES;
+    }
+    break;
+  }
+}
+
+static void targetByteDone()
+{
+  target.instr[target.index++] = target.in;
+  target.in = 0;
+  target.bits = 0;
+
+  if (target.index == 4) {
+    targetExecute(target.instr);
+    target.index = 0;
+    target.out = 0;
+  } else if (target.index == 2) {
+    target.out = target.instr[1]; // the echo that shows we're in sync
+  } else if (target.index == 3) {
+    target.out = target.enabled ? targetRead(target.instr) : 0;
+  } else {
+    target.out = 0;
+  }
+}
+
+static void targetPinChanged(uint8_t pin, uint8_t val)
+{
+  if (pin == PIN_RST) {
+    // Serial programming starts over whenever RESET goes low
+    if (val == LOW) {
+      target.enabled = false;
+      target.in = target.out = target.bits = target.index = 0;
+      hostSetPin(PIN_MISO, LOW);
+    }
+    return;
+  }
+  if (pin != PIN_SCK || hostGetPin(PIN_RST) != LOW)
+    return;
+
+  unsigned long long now = hostCycles();
+  unsigned long phase = now - target.lastEdge;
+  target.lastEdge = now;
+  if (phase < target.shortestPhase)
+    target.shortestPhase = phase;
+
+  if (val == HIGH) {
+    uint8_t bit = hostGetPin(PIN_MOSI);
+    if (phase < target.minPhase)
+      bit ^= 1; // too quick for it
+    target.in = (target.in << 1) | bit;
+    if (++target.bits == 8)
+      targetByteDone();
+  } else {
+    hostSetPin(PIN_MISO, (target.out >> (7 - target.bits)) & 1);
+  }
+}
+
+static void resetTarget(unsigned long minPhase)
+{
+  memset(&target, 0, sizeof(target));
+  target.minPhase = minPhase;
+  target.shortestPhase = ~0UL;
+  target.highFuse = 0xDA;
+  target.lowFuse = 0xFF;
+  for (int n=0; n<PAGE_WORDS; n++)
+    target.pageBuffer[n] = 0xFFFF;
+  for (int n=0; n<FLASH_WORDS; n++)
+    target.flash[n] = 0xFFFF;
+  hostSetPin(PIN_RST, HIGH); // pulled up on the board
+}
+
+static uint8_t instruction(BitBangedSPI *spi, uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+  spi->transfer(a);
+  spi->transfer(b);
+  spi->transfer(c);
+  return spi->transfer(d);
+}
+
+#define SIGNATURE_READS 1000
+
+static void runTransferCase(const char *name, BitBangedSPI *spi, uint32_t clock)
+{
+  resetTarget(3); // a 16MHz target: more than 2 cycles
+  spi->begin();
+  spi->beginTransaction(bbSPISettings(clock, MSBFIRST, 0));
+  digitalWrite(PIN_RST, LOW);
+  pinMode(PIN_RST, OUTPUT);
+  instruction(spi, 0xAC, 0x53, 0x00, 0x00);
+  target.shortestPhase = ~0UL;
+
+  unsigned long errors = 0;
+  unsigned long long start = hostCycles();
+  for (int n=0; n<SIGNATURE_READS; n++) {
+    if (instruction(spi, 0x30, 0x00, n % 3, 0x00) != signature[n % 3])
+      errors++;
+  }
+  double cyclesPerByte = (double)(hostCycles() - start) / (SIGNATURE_READS * 4);
+
+  printf("%-24s %9.1f %8.0f %9lu %7lu\n",
+         name,
+         cyclesPerByte,
+         8.0 * F_CPU / cyclesPerByte / 1000,
+         target.shortestPhase,
+         errors);
+
+  spi->end();
+  pinMode(PIN_RST, INPUT);
+  digitalWrite(PIN_RST, HIGH);
+}
+
+// A 2K image (16 pages), 4 of them blank, as the receiver gets it over
+// the radio: records of 32 data bytes, then the end-of-file record
+#define IMAGE_BYTES 2048
+
+static uint8_t imageByte(int address)
+{
+  if (address >= 512 && address < 1024)
+    return 0xFF;
+  return address * 7 + 1;
+}
+
+static std::vector<std::vector<uint8_t> > imageRecords()
+{
+  std::vector<std::vector<uint8_t> > records;
+  for (int address=0; address<IMAGE_BYTES; address+=32) {
+    std::vector<uint8_t> r = { 3 + 32, (uint8_t)(address >> 8), (uint8_t)address, 0 };
+    for (int i=0; i<32; i++)
+      r.push_back(imageByte(address + i));
+    records.push_back(r);
+  }
+  records.push_back({ 3, 0, 0, 1 });
+  return records;
+}
+
+static bool imageMatches()
+{
+  for (int address=0; address<IMAGE_BYTES; address+=2) {
+    uint16_t w = target.flash[address / 2];
+    if ((w & 0xFF) != imageByte(address) || (w >> 8) != imageByte(address + 1))
+      return false;
+  }
+  return true;
+}
+
+// What programProMini.pl expects the read-back CRC to be
+static uint16_t imageCrc()
+{
+  uint16_t crc = 0xFFFF;
+  for (int address=0; address<IMAGE_BYTES; address++)
+    crc = _crc_ccitt_update(crc, imageByte(address));
+  return crc;
+}
+
+static bool runProgramCase(const char *name, Programmer *programmer, unsigned long minPhase)
+{
+  resetTarget(minPhase);
+  std::vector<std::vector<uint8_t> > records = imageRecords();
+
+  unsigned long long start = hostCycles();
+  ProgrammerStatus ps = PS_OK;
+  for (size_t i=0; i<records.size() && ps == PS_OK; i++) {
+    ps = programmer->parseAndStoreDataFromRadio(records[i].size(), records[i].data());
+  }
+  unsigned long long cycles = hostCycles() - start;
+
+  start = hostCycles();
+  uint16_t crc;
+  bool readBack = programmer->readBackCrc(&crc);
+  unsigned long long verifyCycles = hostCycles() - start;
+  bool good = (ps == PS_FlashComplete && imageMatches() && readBack && crc == imageCrc());
+
+  printf("%-30s %9.1f %6lu %8lu %9.1f %9s\n",
+         name,
+         (double)cycles / (F_CPU / 1000),
+         target.pageWrites,
+         (unsigned long)(programmer->getSpiClock() / 1000),
+         (double)verifyCycles / (F_CPU / 1000),
+         good ? "yes" : "NO");
+  delete programmer;
+  return good;
+}
+
+static bool runStuckCase(const char *name, bool writing, bool erasing)
+{
+  resetTarget(3);
+  target.stuckWriting = writing;
+  target.stuckErasing = erasing;
+  Programmer *programmer = new Programmer(PIN_RST, new FastBitBangedSPI<PIN_SCK, PIN_MOSI, PIN_MISO>());
+  std::vector<std::vector<uint8_t> > records = imageRecords();
+
+  unsigned long long start = hostCycles();
+  ProgrammerStatus ps = PS_OK;
+  size_t i;
+  for (i=0; i<records.size() && ps == PS_OK; i++) {
+    ps = programmer->parseAndStoreDataFromRadio(records[i].size(), records[i].data());
+  }
+  unsigned long long cycles = hostCycles() - start;
+  bool good = (ps == PS_WriteFailed);
+
+  printf("%-30s %9.1f %6lu %8zu %9s\n",
+         name,
+         (double)cycles / (F_CPU / 1000),
+         target.pageWrites,
+         i,
+         good ? "yes" : "NO");
+  delete programmer;
+  return good;
+}
+
+static unsigned long hashesMatched;
+
+static void checkPageHash(uint16_t page, const uint8_t *data)
+{
+  // FNV-1a, as programProMini.pl works it out
+  uint32_t hash = 2166136261UL;
+  for (int i=0; i<PROGRAMMER_PAGE_BYTES; i++)
+    hash = (hash ^ imageByte(page * PROGRAMMER_PAGE_BYTES + i)) * 16777619UL;
+  if (Programmer::pageHash(data) == hash)
+    hashesMatched++;
+}
+
+static bool runHashCase(const char *name, Programmer *programmer)
+{
+  resetTarget(3);
+  std::vector<std::vector<uint8_t> > records = imageRecords();
+  for (size_t i=0; i<records.size(); i++)
+    programmer->parseAndStoreDataFromRadio(records[i].size(), records[i].data());
+
+  const uint16_t pages = IMAGE_BYTES / PROGRAMMER_PAGE_BYTES;
+  hashesMatched = 0;
+  unsigned long long start = hostCycles();
+  bool read = programmer->readPages(0, pages, checkPageHash);
+  unsigned long long cycles = hostCycles() - start;
+  bool good = read && hashesMatched == pages;
+
+  printf("%-30s %9.1f %6u %9s\n",
+         name,
+         (double)cycles / (F_CPU / 1000),
+         pages,
+         good ? "yes" : "NO");
+  delete programmer;
+  return good;
+}
+
+int main()
+{
+  hostPinHook = targetPinChanged;
+  bool ok = true;
+
+  printf("%-24s %9s %8s %9s %7s\n", "transfer", "cyc/byte", "kHz", "min phase", "errors");
+  BitBangedSPI slow(PIN_SCK, PIN_MOSI, PIN_MISO);
+  runTransferCase("BitBangedSPI", &slow, SPI_CLOCK);
+  FastBitBangedSPI<PIN_SCK, PIN_MOSI, PIN_MISO> fast;
+  runTransferCase("FastBitBangedSPI, slow", &fast, SPI_CLOCK);
+  runTransferCase("FastBitBangedSPI", &fast, BBSPI_FAST_CLOCK);
+  ok = ok && (target.shortestPhase >= 3);
+
+  printf("\n%-30s %9s %6s %8s %9s %9s\n", "2K image", "mS", "pages", "SCK kHz", "CRC mS", "verified");
+  ok = runProgramCase("BitBangedSPI",
+                      new Programmer(PIN_RST, PIN_MOSI, PIN_MISO, PIN_SCK), 3) && ok;
+  ok = runProgramCase("FastBitBangedSPI",
+                      new Programmer(PIN_RST, new FastBitBangedSPI<PIN_SCK, PIN_MOSI, PIN_MISO>()), 3) && ok;
+  // A target that needs SCK held for 8 cycles can't sync at the fast
+  // clock; the signature check should send the programmer back to the
+  // slow one
+  ok = runProgramCase("FastBitBangedSPI, slow target",
+                      new Programmer(PIN_RST, new FastBitBangedSPI<PIN_SCK, PIN_MOSI, PIN_MISO>()), 8) && ok;
+
+  printf("\n%-30s %9s %6s %8s %9s\n", "stuck target", "mS", "pages", "records", "reported");
+  ok = runStuckCase("page write never finishes", true, false) && ok;
+  ok = runStuckCase("erase never finishes", false, true) && ok;
+
+  printf("\n%-30s %9s %6s %9s\n", "page hashes", "mS", "pages", "verified");
+  ok = runHashCase("FastBitBangedSPI",
+                   new Programmer(PIN_RST, new FastBitBangedSPI<PIN_SCK, PIN_MOSI, PIN_MISO>())) && ok;
+
+  return ok ? 0 : 1;
+}
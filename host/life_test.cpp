@@ -0,0 +1,139 @@
+/*
+ * Checks Life::evolve()'s bitwise adders against a naive cell-by-cell
+ * count of neighbors on the same 8x24 torus. The board is followed
+ * through showChanges(), as the driver draws it, so this also checks
+ * that the changes it reports (and evolve()'s count of them) add up to
+ * each new generation.
+ *
+ * Then a lone glider, which on this torus comes back to where it
+ * started every 96 generations: inCycle() should catch that, and it
+ * should be a true period-96 cycle rather than a hash collision.
+ */
+
+#include <Arduino.h>
+#include <string.h>
+#include <vector>
+
+// The glider case has to start from an empty board
+#define private public
+#include "Life.h"
+#undef private
+
+#define GENERATIONS 2000
+#define SEEDS 5
+
+typedef bool Board[NUM_RINGS][LEDS_PER_RING];
+
+static Board shown;
+static unsigned long changesShown;
+
+static void lightCell(uint8_t y, uint8_t x, uint32_t v)
+{
+  shown[y][x] = v;
+  changesShown++;
+}
+
+static void naiveEvolve(const Board from, Board to)
+{
+  for (int y=0; y<NUM_RINGS; y++) {
+    for (int x=0; x<LEDS_PER_RING; x++) {
+      int n = 0;
+      for (int dy=-1; dy<=1; dy++) {
+        for (int dx=-1; dx<=1; dx++) {
+          if ((dy || dx) &&
+              from[(y + dy + NUM_RINGS) % NUM_RINGS][(x + dx + LEDS_PER_RING) % LEDS_PER_RING])
+            n++;
+        }
+      }
+      to[y][x] = (n == 3 || (n == 2 && from[y][x]));
+    }
+  }
+}
+
+static bool runSeed(unsigned int seed)
+{
+  srand(seed);
+  memset(shown, 0, sizeof(shown));
+  Life life;
+  life.showChanges(lightCell, 1, 0);
+
+  unsigned long entropy = 0;
+  for (int g=0; g<GENERATIONS; g++) {
+    // As the driver does, when things go quiet
+    if (life.inCycle() || g % 100 == 99) {
+      life.addEntropy();
+      life.showChanges(lightCell, 1, 0);
+      entropy++;
+    }
+
+    Board expected;
+    naiveEvolve(shown, expected);
+
+    uint8_t changes = life.evolve();
+    changesShown = 0;
+    life.showChanges(lightCell, 1, 0);
+
+    if (memcmp(expected, shown, sizeof(shown)) != 0) {
+      printf("FAIL: seed %u generation %d differs from the reference\n", seed, g);
+      return false;
+    }
+    if (changes != changesShown) {
+      printf("FAIL: seed %u generation %d: evolve() counted %u changes, %lu shown\n",
+             seed, g, changes, changesShown);
+      return false;
+    }
+  }
+  printf("seed %u: %d generations match (%lu times with entropy added)\n", seed, GENERATIONS, entropy);
+  return true;
+}
+
+#define GLIDER_PERIOD 96 // 4 generations per diagonal step, 24 steps round
+#define GLIDER_LIMIT  (GLIDER_PERIOD + 2 * MAX_CYCLE_CHECK)
+
+static bool runGlider()
+{
+  Life life;
+  memset(life.universeA, 0, sizeof(life.universeA));
+  memset(life.universeB, 0, sizeof(life.universeB));
+  life.addGlider(5, 3, 0);
+  life.hash = life.hashUniverse();
+  life.resetCycleCheck();
+
+  typedef std::vector<uint32_t> Rings;
+  std::vector<Rings> history;
+  history.push_back(Rings(life.universe, life.universe + NUM_RINGS));
+
+  int g;
+  for (g=1; g<=GLIDER_LIMIT; g++) {
+    life.evolve();
+    history.push_back(Rings(life.universe, life.universe + NUM_RINGS));
+    if (life.inCycle())
+      break;
+  }
+  if (g > GLIDER_LIMIT) {
+    printf("FAIL: glider not caught in %d generations\n", GLIDER_LIMIT);
+    return false;
+  }
+
+  // The shortest period that takes us back to this generation
+  int period = 0;
+  for (int k=1; k<=g && !period; k++) {
+    if (history[g - k] == history[g])
+      period = k;
+  }
+  if (period != GLIDER_PERIOD) {
+    printf("FAIL: glider caught at generation %d with period %d, not %d\n", g, period, GLIDER_PERIOD);
+    return false;
+  }
+  printf("glider: caught at generation %d, period %d\n", g, period);
+  return true;
+}
+
+int main()
+{
+  bool ok = true;
+  for (unsigned int seed=1; seed<=SEEDS; seed++)
+    ok = runSeed(seed) && ok;
+  ok = runGlider() && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include "Adafruit_NeoPixel.h"
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, uint8_t p, uint16_t t)
+{
+  (void) p;
+  (void) t;
+  numLEDs = n;
+  pixels = (uint8_t *)calloc(n, 3);
+  latched = (uint8_t *)calloc(n, 3);
+  resetCounters();
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel()
+{
+  free(pixels);
+  free(latched);
+}
+
+void Adafruit_NeoPixel::begin()
+{
+}
+
+void Adafruit_NeoPixel::show()
+{
+  showCalls++;
+  memcpy(latched, pixels, numLEDs * 3);
+}
+
+void Adafruit_NeoPixel::clear()
+{
+  memset(pixels, 0, numLEDs * 3);
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c)
+{
+  setPixelColor(n, (c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF);
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b)
+{
+  setPixelColorCalls++;
+  if (n < numLEDs) {
+    uint8_t *p = &pixels[n * 3];
+    p[0] = r;
+    p[1] = g;
+    p[2] = b;
+  }
+}
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const
+{
+  getPixelColorCalls++;
+  if (n >= numLEDs)
+    return 0;
+  const uint8_t *p = &pixels[n * 3];
+  return Color(p[0], p[1], p[2]);
+}
+
+uint8_t *Adafruit_NeoPixel::getPixels() const
+{
+  return pixels;
+}
+
+const uint8_t *Adafruit_NeoPixel::getLatchedPixels() const
+{
+  return latched;
+}
+
+uint16_t Adafruit_NeoPixel::numPixels() const
+{
+  return numLEDs;
+}
+
+void Adafruit_NeoPixel::resetCounters()
+{
+  setPixelColorCalls = 0;
+  getPixelColorCalls = 0;
+  showCalls = 0;
+}
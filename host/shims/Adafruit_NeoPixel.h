@@ -0,0 +1,48 @@
+#ifndef __HOST_ADAFRUIT_NEOPIXEL_H
+#define __HOST_ADAFRUIT_NEOPIXEL_H
+
+#include <Arduino.h>
+
+/*
+ * Stand-in for the Adafruit NeoPixel library. Keeps a plain RGB
+ * framebuffer and counts the calls that matter for frame cost.
+ */
+
+#define NEO_RGB  ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRB  ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+#define NEO_KHZ400 0x0100
+
+class Adafruit_NeoPixel {
+ public:
+  Adafruit_NeoPixel(uint16_t n, uint8_t p, uint16_t t);
+  ~Adafruit_NeoPixel();
+
+  void begin();
+  void show();
+  void clear();
+
+  void setPixelColor(uint16_t n, uint32_t c);
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+  uint32_t getPixelColor(uint16_t n) const;
+  uint8_t *getPixels() const;
+  uint16_t numPixels() const;
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+
+  // Host instrumentation
+  void resetCounters();
+  unsigned long setPixelColorCalls;
+  mutable unsigned long getPixelColorCalls;
+  unsigned long showCalls;
+  const uint8_t *getLatchedPixels() const; // what the last show() sent
+
+ private:
+  uint16_t numLEDs;
+  uint8_t *pixels; // 3 bytes per pixel, R/G/B
+  uint8_t *latched;
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "Arduino.h"
+
+#include <deque>
+#include <vector>
+
+static unsigned long simulatedMicros = 0;
+
+static unsigned long long simulatedCycles = 0;
+
+static uint8_t pinModes[256];
+static uint8_t pinValues[256];
+
+void (*hostPinHook)(uint8_t pin, uint8_t val) = NULL;
+
+unsigned long long hostCycles()
+{
+  return simulatedCycles;
+}
+
+void hostAddCycles(unsigned long n)
+{
+  simulatedCycles += n;
+}
+
+static void setPin(uint8_t pin, uint8_t val)
+{
+  if (pinValues[pin] == val)
+    return;
+  pinValues[pin] = val;
+  if (hostPinHook)
+    hostPinHook(pin, val);
+}
+
+void hostSetPin(uint8_t pin, uint8_t val)
+{
+  pinValues[pin] = val ? HIGH : LOW;
+}
+
+uint8_t hostGetPin(uint8_t pin)
+{
+  return pinValues[pin];
+}
+
+// Time passes with the cycles spent (so polling loops time out, as
+// they would on the hardware) as well as with hostAdvanceMillis()
+unsigned long micros()
+{
+  return simulatedMicros + simulatedCycles / (F_CPU / 1000000);
+}
+
+unsigned long millis()
+{
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms)
+{
+  simulatedCycles += (unsigned long long)ms * (F_CPU / 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  simulatedCycles += (unsigned long long)us * (F_CPU / 1000000);
+}
+
+void hostSetMillis(unsigned long ms)
+{
+  simulatedMicros = ms * 1000 - simulatedCycles / (F_CPU / 1000000);
+}
+
+void hostAdvanceMillis(unsigned long ms)
+{
+  simulatedMicros += ms * 1000;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  simulatedCycles += HOST_DIGITALWRITE_CYCLES;
+  setPin(pin, val ? HIGH : LOW);
+}
+
+int digitalRead(uint8_t pin)
+{
+  simulatedCycles += HOST_DIGITALREAD_CYCLES;
+  return pinValues[pin];
+}
+
+MockRegister PORTD(MockRegister::Port, 0), PORTB(MockRegister::Port, 8), PORTC(MockRegister::Port, 14);
+MockRegister PIND(MockRegister::Pin, 0), PINB(MockRegister::Pin, 8), PINC(MockRegister::Pin, 14);
+
+MockRegister::operator uint8_t() const
+{
+  simulatedCycles += 1;
+  uint8_t v = 0;
+  for (int i=0; i<8; i++) {
+    if (pinValues[firstPin + i])
+      v |= _BV(i);
+  }
+  return v;
+}
+
+MockRegister &MockRegister::operator|=(uint8_t mask)
+{
+  simulatedCycles += 2;
+  for (int i=0; i<8; i++) {
+    if (mask & _BV(i))
+      setPin(firstPin + i, HIGH);
+  }
+  return *this;
+}
+
+MockRegister &MockRegister::operator&=(uint8_t mask)
+{
+  simulatedCycles += 2;
+  for (int i=0; i<8; i++) {
+    if (!(mask & _BV(i)))
+      setPin(firstPin + i, LOW);
+  }
+  return *this;
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+  pinValues[pin] = val ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+  (void) pin;
+  return 0;
+}
+
+long random(long howbig)
+{
+  if (howbig == 0)
+    return 0;
+  return ::random() % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig)
+    return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  srandom(seed);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/* Serial */
+
+HardwareSerial Serial;
+
+static std::deque<uint8_t> serialInput;
+static std::vector<uint8_t> serialOutput;
+
+void HardwareSerial::begin(unsigned long baud)
+{
+  (void) baud;
+}
+
+void HardwareSerial::end()
+{
+}
+
+int HardwareSerial::available()
+{
+  return serialInput.size();
+}
+
+int HardwareSerial::read()
+{
+  if (serialInput.empty())
+    return -1;
+  uint8_t b = serialInput.front();
+  serialInput.pop_front();
+  return b;
+}
+
+int HardwareSerial::peek()
+{
+  if (serialInput.empty())
+    return -1;
+  return serialInput.front();
+}
+
+size_t HardwareSerial::write(uint8_t b)
+{
+  serialOutput.push_back(b);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *s, size_t n)
+{
+  serialOutput.insert(serialOutput.end(), s, s + n);
+  return n;
+}
+
+size_t HardwareSerial::write(const char *s, size_t n)
+{
+  return write((const uint8_t *)s, n);
+}
+
+size_t HardwareSerial::print(const char *s)
+{
+  return write(s, strlen(s));
+}
+
+size_t HardwareSerial::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(int v)
+{
+  char buf[12];
+  snprintf(buf, sizeof(buf), "%d", v);
+  return print(buf);
+}
+
+size_t HardwareSerial::print(unsigned long v)
+{
+  char buf[12];
+  snprintf(buf, sizeof(buf), "%lu", v);
+  return print(buf);
+}
+
+size_t HardwareSerial::println(const char *s)
+{
+  return print(s) + print("\r\n");
+}
+
+size_t HardwareSerial::println(int v)
+{
+  return print(v) + print("\r\n");
+}
+
+size_t HardwareSerial::println(unsigned long v)
+{
+  return print(v) + print("\r\n");
+}
+
+void HardwareSerial::hostInject(const uint8_t *d, size_t n)
+{
+  serialInput.insert(serialInput.end(), d, d + n);
+}
+
+size_t HardwareSerial::hostPendingInput()
+{
+  return serialInput.size();
+}
+
+size_t HardwareSerial::hostOutputCount()
+{
+  return serialOutput.size();
+}
+
+const uint8_t *HardwareSerial::hostOutput()
+{
+  return serialOutput.data();
+}
+
+void HardwareSerial::hostClearOutput()
+{
+  serialOutput.clear();
+}
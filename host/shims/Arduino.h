@@ -0,0 +1,132 @@
+#ifndef __HOST_ARDUINO_H
+#define __HOST_ARDUINO_H
+
+/*
+ * Minimal stand-in for the Arduino core, so that the driver sketch and
+ * its classes can be compiled and exercised on a Linux host.
+ *
+ * Time is simulated: millis() only moves when the host harness (or
+ * delay()) moves it, which makes benchmark runs repeatable.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define F_CPU 16000000UL
+#define _BV(b) (1 << (b))
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+int analogRead(uint8_t pin);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+class HardwareSerial {
+ public:
+  void begin(unsigned long baud);
+  void end();
+
+  int available();
+  int read();
+  int peek();
+
+  size_t write(uint8_t b);
+  size_t write(const char *s, size_t n);
+  size_t write(const uint8_t *s, size_t n);
+  size_t print(const char *s);
+  size_t print(char c);
+  size_t print(int v);
+  size_t print(unsigned long v);
+  size_t println(const char *s = "");
+  size_t println(int v);
+  size_t println(unsigned long v);
+
+  // Host harness controls: queue bytes to be read, and inspect what
+  // was written.
+  void hostInject(const uint8_t *d, size_t n);
+  size_t hostPendingInput();
+  size_t hostOutputCount();
+  const uint8_t *hostOutput();
+  void hostClearOutput();
+};
+
+extern HardwareSerial Serial;
+
+// Host harness control of the simulated clock.
+void hostSetMillis(unsigned long ms);
+void hostAdvanceMillis(unsigned long ms);
+
+/*
+ * Port registers, as on the ATmega328P: digital pins 0-7 are port D,
+ * 8-13 port B and 14-19 port C. They share pin state with
+ * digitalWrite()/digitalRead(). Only what bit-banging needs is here:
+ * single-bit sets and clears of PORTx, and reads of PINx.
+ *
+ * Pin I/O also counts CPU cycles (hostCycles()): sbi/cbi and in as the
+ * instructions take, digitalWrite()/digitalRead() as the AVR core
+ * takes, roughly, and the delay functions at F_CPU. Nothing else is
+ * counted, so it's a lower bound on the real thing.
+ */
+#define HOST_DIGITALWRITE_CYCLES 56
+#define HOST_DIGITALREAD_CYCLES  52
+
+class MockRegister {
+ public:
+  enum Kind { Port, Pin };
+  MockRegister(Kind kind, uint8_t firstPin) : kind(kind), firstPin(firstPin) {}
+
+  operator uint8_t() const;              // in / sbic: 1 cycle
+  MockRegister &operator|=(uint8_t mask); // sbi: 2 cycles
+  MockRegister &operator&=(uint8_t mask); // cbi: 2 cycles
+
+ private:
+  Kind kind;
+  uint8_t firstPin;
+};
+
+extern MockRegister PORTB, PORTC, PORTD, PINB, PINC, PIND;
+
+#define __builtin_avr_delay_cycles(n) hostAddCycles(n)
+
+unsigned long long hostCycles();
+void hostAddCycles(unsigned long n);
+
+// Something on the other end of the pins: hostPinHook is called after
+// every change to an output, and hostSetPin()/hostGetPin() drive and
+// look at pins without costing any cycles.
+extern void (*hostPinHook)(uint8_t pin, uint8_t val);
+void hostSetPin(uint8_t pin, uint8_t val);
+uint8_t hostGetPin(uint8_t pin);
+
+#endif
@@ -0,0 +1,74 @@
+#include "RingBuffer.h"
+
+RingBuffer::RingBuffer(int16_t length)
+{
+  this->buffer = (uint8_t *)malloc(length);
+  this->max = length;
+  this->ptr = 0;
+  this->fill = 0;
+}
+
+RingBuffer::~RingBuffer()
+{
+  free(this->buffer);
+}
+
+void RingBuffer::clear()
+{
+  this->fill = 0;
+}
+
+bool RingBuffer::isFull()
+{
+  return (this->max == this->fill);
+}
+
+bool RingBuffer::hasData()
+{
+  return (this->fill != 0);
+}
+
+bool RingBuffer::addByte(uint8_t b)
+{
+  if (this->max == this->fill)
+    return false;
+
+  int16_t idx = (this->ptr + this->fill) % this->max;
+  this->buffer[idx] = b;
+  this->fill++;
+  return true;
+}
+
+bool RingBuffer::addBytes(uint8_t *b, int count)
+{
+  for (int i=0; i<count; i++) {
+    if (!addByte(b[i]))
+      return false;
+  }
+  return true;
+}
+
+uint8_t RingBuffer::consumeByte()
+{
+  if (this->fill == 0)
+    return 0;
+
+  uint8_t ret = this->buffer[this->ptr];
+  this->fill--;
+  this->ptr++;
+  this->ptr %= this->max;
+  return ret;
+}
+
+uint8_t RingBuffer::peek(int16_t idx)
+{
+  if (idx >= this->fill)
+    return 0;
+
+  return this->buffer[(this->ptr + idx) % this->max];
+}
+
+int16_t RingBuffer::count()
+{
+  return this->fill;
+}
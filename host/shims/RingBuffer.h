@@ -0,0 +1,33 @@
+#ifndef __HOST_RINGBUFFER_H
+#define __HOST_RINGBUFFER_H
+
+#include <Arduino.h>
+
+/*
+ * Host copy of the RingBuffer library's interface
+ * (https://github.com/JorjBauer/RingBuffer).
+ */
+
+class RingBuffer {
+ public:
+  RingBuffer(int16_t length);
+  ~RingBuffer();
+
+  void clear();
+
+  bool isFull();
+  bool hasData();
+  bool addByte(uint8_t b);
+  bool addBytes(uint8_t *b, int count);
+  uint8_t consumeByte();
+  uint8_t peek(int16_t idx);
+  int16_t count();
+
+ private:
+  uint8_t *buffer;
+  int16_t max;
+  int16_t ptr;
+  int16_t fill;
+};
+
+#endif
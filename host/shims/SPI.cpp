@@ -0,0 +1,73 @@
+#include "SPI.h"
+
+#define RAMREAD 0x03
+#define RAMWRITE 0x02
+#define RDMR 0x05
+#define WRMR 0x01
+
+#define SRAM_BYTE_MODE 0x00
+
+SPIClass SPI;
+
+SPIClass::SPIClass()
+{
+  memset(sram, 0, sizeof(sram));
+  sramMode = 0x40; // the 23LC1024 powers up in sequential mode
+  transferCalls = 0;
+  phase = 0;
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+  (void) settings;
+  phase = 0;
+}
+
+void SPIClass::endTransaction()
+{
+  phase = 0;
+}
+
+uint8_t SPIClass::transfer(uint8_t b)
+{
+  transferCalls++;
+  delayMicroseconds(1); // 8 bits at 8MHz, plus the AVR's loop overhead
+
+  if (phase == 0) {
+    command = b;
+    address = 0;
+    phase++;
+    return 0;
+  }
+
+  if (command == WRMR) {
+    if (phase == 1)
+      sramMode = b;
+    phase = 2;
+    return 0;
+  }
+  if (command == RDMR) {
+    return sramMode;
+  }
+  if (command != RAMREAD && command != RAMWRITE)
+    return 0;
+
+  if (phase < 4) {
+    address = (address << 8) | b;
+    phase++;
+    return 0;
+  }
+
+  // Byte mode only moves one byte per command
+  if (sramMode == SRAM_BYTE_MODE && phase > 4)
+    return 0;
+  phase = 5;
+
+  uint32_t a = address % HOST_SRAM_SIZE;
+  address++;
+  if (command == RAMWRITE) {
+    sram[a] = b;
+    return 0;
+  }
+  return sram[a];
+}
@@ -0,0 +1,54 @@
+#ifndef __HOST_SPI_H
+#define __HOST_SPI_H
+
+#include <Arduino.h>
+
+/*
+ * Stand-in for the Arduino SPI library. The only SPI device on the
+ * driver is a 23LC1024 serial SRAM, so that's what's on the other end
+ * of the bus: a transaction is one command (READ, WRITE, RDMR, WRMR),
+ * then for READ/WRITE a 24-bit address and data bytes. Chip select
+ * isn't modeled; every beginTransaction() starts a new command.
+ */
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+#define HOST_SRAM_SIZE 131072
+
+class SPISettings {
+ public:
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {
+    (void) clock;
+    (void) bitOrder;
+    (void) dataMode;
+  }
+};
+
+class SPIClass {
+ public:
+  SPIClass();
+
+  void begin() {}
+  void end() {}
+  void beginTransaction(SPISettings settings);
+  void endTransaction();
+  uint8_t transfer(uint8_t b);
+
+  // Host instrumentation
+  unsigned long transferCalls;
+  uint8_t *hostSram() { return sram; }
+
+ private:
+  uint8_t sram[HOST_SRAM_SIZE];
+  uint8_t sramMode;  // as set by WRMR
+  uint8_t command;
+  uint8_t phase;     // command, address bytes, then data (saturates at 5)
+  uint32_t address;
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef __HOST_AVR_PGMSPACE_H
+#define __HOST_AVR_PGMSPACE_H
+
+// Nothing needed on the host; <Arduino.h> supplies PROGMEM and friends.
+#include <Arduino.h>
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef __HOST_UTIL_CRC16_H
+#define __HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+// avr-libc's CRC-16/CCITT step, from its documented C equivalent
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+  data ^= crc & 0xFF;
+  data ^= data << 4;
+  return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef __HOST_UTIL_DELAY_H
+#define __HOST_UTIL_DELAY_H
+
+// Nothing needed on the host; <Arduino.h> supplies PROGMEM and friends.
+#include <Arduino.h>
+
+#endif
@@ -0,0 +1,35 @@
+#include "HSV.h"
+
+// x / 255, rounded down, for 0 <= x <= 65025 (i.e. 255 * 255)
+static inline uint8_t div255(uint16_t x)
+{
+  return (x + 1 + (x >> 8)) >> 8;
+}
+
+// For sf = s * (fraction of a 60-degree sector, in degrees), return
+// 255 * (1 - sf / (255 * 60)), rounded. sf is at most 255 * 60.
+static inline uint8_t oneMinus(uint16_t sf)
+{
+  return (uint16_t)(255 * 60 - sf + 30) / 60;
+}
+
+void hsv_to_rgb8(uint16_t h, uint8_t s, uint8_t v,
+                 uint8_t *r, uint8_t *g, uint8_t *b)
+{
+  h %= 360;
+  uint8_t sector = h / 60;
+  uint8_t degrees = h - sector * 60; // how far in to the sector we are
+
+  uint8_t p1 = div255(v * (uint16_t)(255 - s));
+  uint8_t p2 = div255(v * (uint16_t)oneMinus(s * (uint16_t)degrees));
+  uint8_t p3 = div255(v * (uint16_t)oneMinus(s * (uint16_t)(60 - degrees)));
+
+  switch (sector) {
+  case 0:  *r = v;  *g = p3; *b = p1; break;
+  case 1:  *r = p2; *g = v;  *b = p1; break;
+  case 2:  *r = p1; *g = v;  *b = p3; break;
+  case 3:  *r = p1; *g = p2; *b = v;  break;
+  case 4:  *r = p3; *g = p1; *b = v;  break;
+  default: *r = v;  *g = p1; *b = p2; break;
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef __HSV_H
+#define __HSV_H
+
+#include <Arduino.h>
+
+/*
+ * HSV to RGB conversion in 8- and 16-bit integer math, shared by the
+ * driver and receiver sketches. There's no FPU on the AVR, so this
+ * replaces a double-precision version that had to use soft-float.
+ *
+ * h is in degrees (any value; taken mod 360); s and v are 0-255, where
+ * 255 is fully saturated / full brightness. Results are within 1 of the
+ * old floating-point version for every input.
+ */
+
+void hsv_to_rgb8(uint16_t h, uint8_t s, uint8_t v,
+                 uint8_t *r, uint8_t *g, uint8_t *b);
+
+#endif
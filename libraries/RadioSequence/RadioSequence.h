@@ -0,0 +1,34 @@
+#ifndef __RADIOSEQUENCE_H
+#define __RADIOSEQUENCE_H
+
+/*
+ * Sequenced packets from the gateway to the receiver, shared by both
+ * sketches. The gateway keeps several packets in flight at once instead
+ * of waiting on each ACK; the receiver hands them to the driver strictly
+ * in order.
+ *
+ * A sequenced packet is SEQ_MARK (or SEQ_SYNC), a sequence number, then
+ * the data. Driver commands are all 7-bit, so no ordinary packet starts
+ * with either marker.
+ *
+ * SEQ_SYNC tells the receiver to expect this sequence number from now
+ * on. The gateway sends it first, and again after giving up on a
+ * packet; nothing else goes until it has been ACKed.
+ *
+ * The receiver ACKs with SEQ_MARK and the sequence number. It drops
+ * (without ACKing) anything after a gap, so an ACK also covers every
+ * packet before it. Repeats of packets it already has are ACKed again.
+ *
+ * A receiver that hasn't been synced (it's been reset since) answers
+ * SEQ_MARK packets with SEQ_SYNC and the sequence number instead; the
+ * gateway then sends everything in flight again, the oldest as a sync
+ * packet.
+ */
+
+#define SEQ_MARK   0xFE
+#define SEQ_SYNC   0xFD
+#define SEQ_HEADER 2 // marker, sequence number
+
+#define isSequenced(b) ((b) == SEQ_MARK || (b) == SEQ_SYNC)
+
+#endif
@@ -1,4 +1,5 @@
 #include "Programmer.h"
+#include <util/crc16.h>
 
 /* Janky bit-banged Arduino programmer
  *  
@@ -11,6 +12,7 @@
  *      - currentPage and the commit mechanism are written from the 328P's spec
  *      - requires that target flash be erased before trying to program
  *    - HEX file ends cleanly with ":00000001FF"
+ *    - pages that would be all 0xFF are left as the erase left them
  * 
  * Note that it's possible to use this to enable/disable and replace
  * the bootloader.
@@ -46,6 +48,19 @@
  */
 
 #define SPI_CLOCK     (1000000/6)
+#define SPI_FAST_CLOCK BBSPI_FAST_CLOCK // asks a FastBitBangedSPI for its fast path
+
+// Entering programming mode, per the datasheet's serial programming
+// algorithm: a reset pulse of at least two target clocks (this covers
+// targets down to 200kHz), then at least 20mS before Programming Enable
+#define RESET_PULSE_US 10
+#define ENTRY_DELAY    20
+#define ENTRY_TRIES    3
+
+// Caps on polling RDY/BSY; these were the fixed delays it replaces. The
+// 328P typically needs 4.5mS for a page or fuse write, 9mS for an erase.
+#define WRITE_TIMEOUT  10
+#define ERASE_TIMEOUT  18
 
 // Intel Hex datatype constants
 #define IH_DATA 0
@@ -65,7 +80,26 @@ Programmer::Programmer(byte rst, byte mosi, byte miso, byte sck) : rst(rst), sck
   bbSPI = new BitBangedSPI(sck, mosi, miso);
   bbSPI->begin();
 
+  spiClock = SPI_CLOCK;
+  sckRate = 0;
+  lastProgrammedPage = 0;
+  pageDirty = false;
+  imageStart = imageEnd = 0;
+  programmingStarted = false;
+}
+
+// ... or with a ready-made bit-banger; a FastBitBangedSPI, whose pins
+// are fixed at compile time, is much quicker than the one above.
+Programmer::Programmer(byte rst, BitBangedSPI *spi) : rst(rst), sck(spi->getSckPin())
+{
+  bbSPI = spi;
+  bbSPI->begin();
+
+  spiClock = SPI_FAST_CLOCK;
+  sckRate = 0;
   lastProgrammedPage = 0;
+  pageDirty = false;
+  imageStart = imageEnd = 0;
   programmingStarted = false;
 }
 
@@ -74,6 +108,7 @@ Programmer::~Programmer()
   // Reset the SPI pins as inputs so they all float, and the target device can 
   // use SPI as it sees fit
   bbSPI->end();
+  delete bbSPI;
 }
 
 uint8_t Programmer::spiTransaction(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
@@ -83,13 +118,39 @@ uint8_t Programmer::spiTransaction(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
   return bbSPI->transfer(d);
 }
 
-void Programmer::commit(int page)
+// Poll RDY/BSY until the last write or erase is done
+bool Programmer::waitUntilReady(uint8_t timeout)
+{
+  unsigned long start = millis();
+  while (spiTransaction(0xF0, 0x00, 0x00, 0x00) & 0x01) {
+    if (millis() - start > timeout)
+      return false;
+  }
+  return true;
+}
+
+// Write the loaded page buffer; false if the target never finished
+bool Programmer::commit(int page)
 {
     spiTransaction(0x4C, (page >> 8) & 0xFF, page & 0xFF, 0);
-    delay(10); // delay of > 9mS, per datasheet for the 328P
+    return waitUntilReady(WRITE_TIMEOUT);
 }
 
+// Start at the fast clock; if the target doesn't give us its signature
+// there, fall back to the slow one (and stay there)
 bool Programmer::enterProgrammingMode()
+{
+  if (tryProgrammingMode(spiClock))
+    return true;
+  if (spiClock == SPI_CLOCK)
+    return false;
+
+  leaveProgrammingMode();
+  spiClock = SPI_CLOCK;
+  return tryProgrammingMode(spiClock);
+}
+
+bool Programmer::tryProgrammingMode(uint32_t clock)
 {
   // reset the target
   digitalWrite(rst, LOW);
@@ -98,32 +159,43 @@ bool Programmer::enterProgrammingMode()
   
   // put the target in programming mode
   bbSPI->begin();
-  bbSPI->beginTransaction(bbSPISettings(SPI_CLOCK, MSBFIRST, SPI_MODE0));
+  bbSPI->beginTransaction(bbSPISettings(clock, MSBFIRST, SPI_MODE0));
   
-  // Pull SCK low, then pulse the reset line
+  // Pull SCK low, then pulse the reset line. If the target isn't in
+  // sync, the datasheet says to pulse it again and start over.
   digitalWrite(sck, LOW);
-  delay(40); // let it discharge (datasheet says "at least 20ms")
-  digitalWrite(rst, HIGH);
-  delayMicroseconds(100); // ArduinoISP and docs agree – this must be > 2 target CPU clock cycles
-  digitalWrite(rst, LOW);
-  
-  // Send the "enable programming" command
-  delay(50); // Not sure this is required, but it doesn't hurt
-  spiTransaction(0xAC, 0x53, 0x00, 0x00);
-  
-  // read the signature
-  uint8_t high   = spiTransaction(0x30, 0x00, 0x00, 0x00); // Device ID: should be 0x1E
-  uint8_t middle = spiTransaction(0x30, 0x00, 0x01, 0x00); // flash size: 0x95 on the 328P
-  uint8_t low    = spiTransaction(0x30, 0x00, 0x02, 0x00); // device family: 0x0F for the 328P
-  
-  if (high != 0x1E || middle != 0x95 || low != 0x0F) {
-    // ... If the signature is bad, bail; there's either a communication 
-    // problem or the wrong device is on the other end.
-    Serial.println("Bad signature");
-    return false;
+  for (uint8_t tries = 0; tries < ENTRY_TRIES; tries++) {
+    digitalWrite(rst, HIGH);
+    delayMicroseconds(RESET_PULSE_US);
+    digitalWrite(rst, LOW);
+    delay(ENTRY_DELAY);
+
+    // Send the "enable programming" command; in sync, the target echoes
+    // the 0x53 back while we send the third byte
+    bbSPI->transfer(0xAC);
+    bbSPI->transfer(0x53);
+    uint8_t echo = bbSPI->transfer(0x00);
+    bbSPI->transfer(0x00);
+    if (echo != 0x53)
+      continue;
+
+    // read the signature, timing it: the clocks asked for are nominal,
+    // and bit-banging never quite reaches them
+    unsigned long start = micros();
+    uint8_t high   = spiTransaction(0x30, 0x00, 0x00, 0x00); // Device ID: should be 0x1E
+    uint8_t middle = spiTransaction(0x30, 0x00, 0x01, 0x00); // flash size: 0x95 on the 328P
+    uint8_t low    = spiTransaction(0x30, 0x00, 0x02, 0x00); // device family: 0x0F for the 328P
+    unsigned long us = micros() - start;
+    sckRate = us ? (3 * 4 * 8 * 1000000UL) / us : 0;
+
+    if (high == 0x1E && middle == 0x95 && low == 0x0F)
+      return true;
   }
-  
-  return true;
+
+  // ... If the signature is still bad, bail; there's either a communication
+  // problem or the wrong device is on the other end.
+  Serial.println("Bad signature");
+  return false;
 }
 
 void Programmer::leaveProgrammingMode()
@@ -136,18 +208,26 @@ void Programmer::leaveProgrammingMode()
 }
 
 // Read each line, and return PS_FlashComplete when we receive the
-// terminator; PS_OK for good lines; and PS_SyntaxError if there's a
-// problem
+// terminator; PS_OK for good lines; PS_SyntaxError if there's a
+// problem with the line; and PS_WriteFailed if the target couldn't be
+// erased or programmed (after which the next line starts over)
 ProgrammerStatus Programmer::parseAndStoreDataFromRadio(uint8_t len, uint8_t *data)
 {
   ProgrammerStatus ret = PS_OK;
   
   if (!programmingStarted) {
-    eraseTarget();
+    if (!eraseTarget())
+      return PS_WriteFailed;
 
-    enterProgrammingMode();
+    if (!enterProgrammingMode()) {
+      leaveProgrammingMode();
+      return PS_WriteFailed;
+    }
     programmingStarted = true;
     lastProgrammedPage = 0;
+    pageDirty = false;
+    imageStart = 0xFFFFFFFF;
+    imageEnd = 0;
   }
 
   // The data received is binary, of the form
@@ -172,6 +252,12 @@ ProgrammerStatus Programmer::parseAndStoreDataFromRadio(uint8_t len, uint8_t *da
   else if (type != IH_DATA) {
     ret = PS_SyntaxError;
   }
+  else if (count > 0) {
+    if ((uint32_t)address < imageStart)
+      imageStart = address;
+    if ((uint32_t)address + count > imageEnd)
+      imageEnd = address + count;
+  }
 
   while ((ret == PS_OK) && (count>0)) {
     byte b1 = *data;
@@ -180,12 +266,21 @@ ProgrammerStatus Programmer::parseAndStoreDataFromRadio(uint8_t len, uint8_t *da
     data++;
 
     if (currentPage(progmemAddress) != lastProgrammedPage) {
-      commit(lastProgrammedPage);
+      if (pageDirty && !commit(lastProgrammedPage)) {
+        ret = PS_WriteFailed;
+        break;
+      }
       lastProgrammedPage = currentPage(progmemAddress);
+      pageDirty = false;
     }
 
-    spiTransaction(0x40, 0x00, progmemAddress & 0x3F, b1); // low byte first
-    spiTransaction(0x48, 0x00, progmemAddress & 0x3F, b2);
+    // The target's been erased, so 0xFFFF is already there; a page of
+    // nothing else needn't be written at all
+    if (b1 != 0xFF || b2 != 0xFF) {
+      spiTransaction(0x40, 0x00, progmemAddress & 0x3F, b1); // low byte first
+      spiTransaction(0x48, 0x00, progmemAddress & 0x3F, b2);
+      pageDirty = true;
+    }
     
     progmemAddress++; // advance one word for the two bytes
     count-=2;
@@ -193,8 +288,11 @@ ProgrammerStatus Programmer::parseAndStoreDataFromRadio(uint8_t len, uint8_t *da
 
   if (ret == PS_FlashComplete) {
     // End of file!
-    commit(lastProgrammedPage);
+    if (pageDirty && !commit(lastProgrammedPage))
+      ret = PS_WriteFailed;
+  }
 
+  if (ret == PS_FlashComplete || ret == PS_WriteFailed) {
     leaveProgrammingMode();
     programmingStarted = 0;
   }
@@ -202,6 +300,61 @@ ProgrammerStatus Programmer::parseAndStoreDataFromRadio(uint8_t len, uint8_t *da
   return ret;
 }
 
+// Read back everything the image covered (gaps read as the erased 0xFF)
+// and CRC it, so that the sender can check it against the .hex file.
+// The CRC is CRC-16/CCITT as _crc_ccitt_update() does it, from 0xFFFF.
+bool Programmer::readBackCrc(uint16_t *crc)
+{
+  *crc = 0xFFFF;
+  if (!enterProgrammingMode())
+    return false;
+
+  for (uint32_t a = imageStart; a < imageEnd; a++) {
+    uint16_t word = a >> 1;
+    uint8_t b = spiTransaction((a & 1) ? 0x28 : 0x20, word >> 8, word & 0xFF, 0x00); // high byte : low byte
+    *crc = _crc_ccitt_update(*crc, b);
+  }
+
+  leaveProgrammingMode();
+  return true;
+}
+
+// Read whole pages of the target's flash, one at a time, for the
+// caller to hash or keep (so that only the pages that differ from a new
+// image need to come over the radio)
+bool Programmer::readPages(uint16_t firstPage, uint16_t count, PageReader reader)
+{
+  uint8_t data[PROGRAMMER_PAGE_BYTES];
+
+  if (!enterProgrammingMode())
+    return false;
+
+  for (uint16_t page = firstPage; page < firstPage + count; page++) {
+    uint16_t word = page * (PROGRAMMER_PAGE_BYTES / 2);
+    for (uint8_t i = 0; i < PROGRAMMER_PAGE_BYTES; i += 2, word++) {
+      data[i] = spiTransaction(0x20, word >> 8, word & 0xFF, 0x00);
+      data[i+1] = spiTransaction(0x28, word >> 8, word & 0xFF, 0x00);
+    }
+    reader(page, data);
+  }
+
+  leaveProgrammingMode();
+  return true;
+}
+
+// 32-bit FNV-1a of one page. Deliberately not readBackCrc()'s CRC: a
+// changed page whose CRC matched the old one's would leave the whole
+// image's CRC unchanged too, so nothing would catch it being skipped.
+uint32_t Programmer::pageHash(const uint8_t *data)
+{
+  uint32_t hash = 2166136261UL;
+  for (uint8_t i = 0; i < PROGRAMMER_PAGE_BYTES; i++) {
+    hash ^= data[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
 uint8_t Programmer::getHighFuse()
 {
   if (!enterProgrammingMode())
@@ -236,9 +389,10 @@ bool Programmer::setHighFuse(uint8_t b)
   b &= ~(1 << 5); // Enable SPI programming
 
   spiTransaction(0xAC, 0xA8, 0x00, b);
+  bool ready = waitUntilReady(WRITE_TIMEOUT);
   
   leaveProgrammingMode();
-  return true;
+  return ready;
 }
 
 bool Programmer::setLowFuse(uint8_t b)
@@ -247,9 +401,10 @@ bool Programmer::setLowFuse(uint8_t b)
     return false;
 
   spiTransaction(0xAC, 0xA0, 0x00, b);
+  bool ready = waitUntilReady(WRITE_TIMEOUT);
   
   leaveProgrammingMode();
-  return true;
+  return ready;
 }
 
 bool Programmer::eraseTarget()
@@ -258,9 +413,9 @@ bool Programmer::eraseTarget()
     return false;
     
   spiTransaction(0xAC, 0x80, 0x00, 0x00);
-  delay(18); // 9 should be sufficient, but had trouble; 18 (arbitrarily doubling it) seems fine
+  bool ready = waitUntilReady(ERASE_TIMEOUT);
 
   leaveProgrammingMode();
 
-  return true;
+  return ready;
 }
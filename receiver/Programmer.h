@@ -8,38 +8,58 @@
 )))
 #define ONEBYTE(l,r) ((FROMHEX(l) << 4) | FROMHEX(r))
 
+// Pages are 64 words on the 328P
+#define PROGRAMMER_PAGE_BYTES 128
+
+// Handed each page readPages() gets from the target
+typedef void (*PageReader)(uint16_t page, const uint8_t *data);
+
 enum ProgrammerStatus {
   PS_Invalid = -1,
   PS_OK = 0,
   PS_SyntaxError,
   PS_InvalidPacket,
-  PS_FlashComplete
+  PS_FlashComplete,
+  PS_WriteFailed
 };
 
 class Programmer {
  public:
   Programmer(byte rst, byte mosi, byte miso, byte sck);
+  Programmer(byte rst, BitBangedSPI *spi); // takes ownership of spi
   ~Programmer();
 
   ProgrammerStatus parseAndStoreDataFromRadio(uint8_t len, uint8_t *data);
+  bool readBackCrc(uint16_t *crc);
+  bool readPages(uint16_t firstPage, uint16_t count, PageReader reader);
+  static uint32_t pageHash(const uint8_t *data);
   uint8_t getHighFuse();
   uint8_t getLowFuse();
   bool setHighFuse(uint8_t b);
   bool setLowFuse(uint8_t b);
   bool eraseTarget();
 
+  uint32_t getSpiClock() const { return sckRate; } // as measured, in Hz
+
  protected:
   uint8_t spiTransaction(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
-  void commit(int page);
+  bool commit(int page);
+  bool waitUntilReady(uint8_t timeout);
 
   bool enterProgrammingMode();
+  bool tryProgrammingMode(uint32_t clock);
   void leaveProgrammingMode();
   
  private:
   byte rst, mosi, miso, sck;
 
   BitBangedSPI *bbSPI;
+  uint32_t spiClock; // drops to SPI_CLOCK if the target won't sync faster
+  uint32_t sckRate;  // what that actually came to, over the signature read
 
   uint32_t lastProgrammedPage;
+  bool pageDirty;      // anything loaded since the last commit?
+  uint32_t imageStart; // byte addresses the image covers
+  uint32_t imageEnd;
   bool programmingStarted;
 };
@@ -12,12 +12,14 @@ private:
   uint32_t clock;
 
 friend class BitBangedSPI;
+template <byte, byte, byte> friend class FastBitBangedSPI;
 };
 
 class BitBangedSPI {
 public:
   BitBangedSPI(byte sck, byte mosi, byte miso) : sck(sck), mosi(mosi), miso(miso)
   {}
+  virtual ~BitBangedSPI() {}
 
   void begin() {
     digitalWrite(sck, LOW);
@@ -27,7 +29,7 @@ public:
     pinMode(miso, INPUT);
   }
 
-  void beginTransaction(bbSPISettings settings) {
+  virtual void beginTransaction(bbSPISettings settings) {
     pulseWidth = (500000 + settings.clock - 1) / settings.clock;
     if (pulseWidth == 0)
       pulseWidth = 1;
@@ -39,7 +41,7 @@ public:
     /* pinMode(miso, INPUT); -- it's already an input. */
   }
 
-  uint8_t transfer (uint8_t b) {
+  virtual uint8_t transfer (uint8_t b) {
     for (unsigned int i = 0; i < 8; ++i) {
       digitalWrite(mosi, (b & 0x80) ? HIGH : LOW);
       digitalWrite(sck, HIGH);
@@ -51,7 +53,78 @@ public:
     return b;
   }
 
+  byte getSckPin() const { return sck; }
+
 private:
   unsigned long pulseWidth; // in microseconds
   byte sck, mosi, miso;
 };
+
+/* Direct port access to one ATmega328P pin (digital 0-7 are port D,
+ * 8-13 port B, 14-19 port C), chosen at compile time: each of these is
+ * a single sbi/cbi/sbic instead of a trip through digitalWrite()'s
+ * lookup tables.
+ */
+template <byte pin> struct FastPin {
+  static const uint8_t mask = _BV(pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14);
+
+  static inline void high() {
+    if (pin < 8) PORTD |= mask; else if (pin < 14) PORTB |= mask; else PORTC |= mask;
+  }
+  static inline void low() {
+    if (pin < 8) PORTD &= ~mask; else if (pin < 14) PORTB &= ~mask; else PORTC &= ~mask;
+  }
+  static inline uint8_t read() {
+    return ((pin < 8 ? PIND : pin < 14 ? PINB : PINC) & mask) ? 1 : 0;
+  }
+};
+
+/* The target needs SCK high and low for more than 2 of its clock cycles
+ * each (3 at 12MHz and up); padding each half-bit with
+ * BBSPI_FAST_PAD cycles on top of the port instructions themselves
+ * keeps it above that for a 16MHz target.
+ *
+ * BBSPI_FAST_CLOCK is only the threshold for taking that path, not the
+ * rate it runs at: with the loop around it, a byte takes about 88
+ * cycles (see host/isp_bench), so SCK is nearer F_CPU/11.
+ */
+#define BBSPI_FAST_PAD   2
+#define BBSPI_FAST_CLOCK (F_CPU / 8)
+
+/* BitBangedSPI with the pins fixed at compile time. A transaction at
+ * BBSPI_FAST_CLOCK or more uses the port-register path; anything
+ * slower is timed by delayMicroseconds() as before, so a caller can
+ * always drop back to a clock the target is sure to accept.
+ */
+template <byte sckPin, byte mosiPin, byte misoPin>
+class FastBitBangedSPI : public BitBangedSPI {
+public:
+  FastBitBangedSPI() : BitBangedSPI(sckPin, mosiPin, misoPin), fast(false)
+  {}
+
+  virtual void beginTransaction(bbSPISettings settings) {
+    fast = (settings.clock >= BBSPI_FAST_CLOCK);
+    BitBangedSPI::beginTransaction(settings);
+  }
+
+  virtual uint8_t transfer (uint8_t b) {
+    if (!fast)
+      return BitBangedSPI::transfer(b);
+
+    for (uint8_t i = 0; i < 8; ++i) {
+      if (b & 0x80)
+        FastPin<mosiPin>::high();
+      else
+        FastPin<mosiPin>::low();
+      FastPin<sckPin>::high();
+      __builtin_avr_delay_cycles(BBSPI_FAST_PAD);
+      b = (b << 1) | FastPin<misoPin>::read();
+      FastPin<sckPin>::low();
+      __builtin_avr_delay_cycles(BBSPI_FAST_PAD);
+    }
+    return b;
+  }
+
+private:
+  bool fast;
+};
@@ -11,6 +11,9 @@
 #include <RingBuffer.h>
 #include "Programmer.h"
 #include "Clock.h"
+#include <HSV.h>           // in this repository's libraries/ directory
+#include <RadioSequence.h> // ... as is this
+#include <util/crc16.h>
 
 // degrees C
 #define MAXTEMP 60
@@ -46,8 +49,51 @@ unsigned long tempTimer = 0;
 RFM69 radio;
 SPIFlash flash(FLASH_SS, 0xEF30); //EF30 for windbond 4mbit flash
 
-// ring buffer that accepts data from wireless to send out serial
-RingBuffer serialBuffer(128);
+// ring buffer that accepts data from wireless to send out serial. Big
+// enough for two full radio packets (RF69_MAX_DATA_LEN), so one can
+// arrive while the last is still going out, plus our own commands.
+#define SERIAL_BUFFER_SIZE 128
+#define SERIAL_ROOM_WAIT 50 // mS to wait for the driver to make room for a packet
+RingBuffer serialBuffer(SERIAL_BUFFER_SIZE);
+uint8_t serialBufferHighWater = 0; // most bytes ever waiting in serialBuffer
+uint16_t serialBufferDrops = 0;    // bytes lost because it was full
+
+// Uplink: what the driver sends back, collected in to as few radio
+// packets to the gateway as we can. A packet goes when it's full, or
+// when nothing more has arrived for UPLINK_IDLE mS.
+#define UPLINK_IDLE 3
+uint8_t uplinkPacket[RF69_MAX_DATA_LEN];
+uint8_t uplinkLen = 0;
+unsigned long uplinkLastByte = 0;
+
+// Driver firmware staged in SPIFlash before it's burned (see
+// enterStagedFlashMode()); well clear of our own wireless-programming
+// image, which CheckForWirelessHEX() keeps at the start of the flash.
+#define STAGE_ADDR   0x20000
+#define STAGE_MAX    32768 // the 328P's flash
+#define STAGE_SECTOR 4096  // erased a sector at a time, as it fills
+#define STAGE_RECORD 64    // bytes per record handed to the Programmer
+uint16_t stageLength = 0;  // the image the host told us it's sending
+uint16_t stageCrc = 0;
+uint16_t stageOffset = 0;  // how much of it we have so far
+uint16_t stageErasedTo = 0;
+
+// Delta updates (see hashPages()): the staging area holds a copy of
+// what's on the target, and only the pages that changed come over the
+// radio, in to the delta area at their own offsets. Both buffers are
+// read a page at a time (see stageAddress()).
+#define DELTA_ADDR   (STAGE_ADDR + STAGE_MAX)
+#define STAGE_PAGES  (STAGE_MAX / PROGRAMMER_PAGE_BYTES)
+#define HASH_PAGES   8 // page hashes per ACK; reading them mustn't outlast the gateway's ACK wait
+bool stageDelta = false;
+uint8_t deltaPages[STAGE_PAGES / 8];   // which pages are in the delta area
+uint8_t deltaErased = 0;               // which of its sectors have been erased
+uint8_t hashReply[4 * HASH_PAGES];
+uint8_t hashReplyLen = 0;
+
+// Sequenced packets from the gateway (see RadioSequence.h)
+uint8_t rxExpectedSeq = 0;
+bool rxSynced = false;
 
 Clock clock;
 
@@ -70,42 +116,11 @@ void clearTextMode()
   addBufferData((uint8_t *)"\0\0", 2); // DUH can't add "\0" as a STRING you dolt
 }
 
-void
-hsv_to_rgb (int h, double s, double v,
-            uint8_t *r, uint8_t *g, uint8_t *b)
-{
-  double H, S, V, R, G, B;
-  double p1, p2, p3;
-  double f;
-  int i;
-
-  if (s < 0) s = 0;
-  if (v < 0) v = 0;
-  if (s > 1) s = 1;
-  if (v > 1) v = 1;
-  S = s; V = v;
-  H = (h % 360) / 60.0;
-  i = H;
-  f = H - i;
-  p1 = V * (1 - S);
-  p2 = V * (1 - (S * f));
-  p3 = V * (1 - (S * (1 - f)));
-  if      (i == 0) { R = V;  G = p3; B = p1; }
-  else if (i == 1) { R = p2; G = V;  B = p1; }
-  else if (i == 2) { R = p1; G = V;  B = p3; }
-  else if (i == 3) { R = p1; G = p2; B = V;  }
-  else if (i == 4) { R = p3; G = p1; B = V;  }
-  else             { R = V;  G = p1; B = p2; }
-  *r = R * 255;
-  *g = G * 255;
-  *b = B * 255;
-}
-
 void randomColor(uint8_t *r, uint8_t *g, uint8_t *b)
 {
-  double v = ((double) random(0,75) / 100.0) + 0.25; // random (0.75) + 0.25
+  uint8_t v = random(64, 253); // 0.25 to 0.99 of full brightness
   // Set r, g, b with our random number, which we'll pick out of the HSV space.
-  hsv_to_rgb(random(0, 360), 1.0, v, 
+  hsv_to_rgb8(random(0, 360), 255, v, 
               r, g, b);
 }
 
@@ -139,7 +154,58 @@ void setup() {
 
 void addBufferByte(volatile uint8_t d)
 {
-  serialBuffer.addByte(d);
+  if (!serialBuffer.addByte(d)) {
+    serialBufferDrops++;
+    return;
+  }
+  if (serialBuffer.count() > serialBufferHighWater) {
+    serialBufferHighWater = serialBuffer.count();
+  }
+}
+
+// Send the driver as much buffered data as its CTS and our serial
+// transmit buffer will take right now, without blocking
+void forwardBufferData()
+{
+  while (serialBuffer.hasData() && Serial.availableForWrite() > 0
+#ifdef CTSPIN
+         && digitalRead(CTSPIN)
+#endif
+         ) {
+    Serial.write(serialBuffer.consumeByte());
+  }
+}
+
+void flushUplink()
+{
+  if (uplinkLen) {
+    radio.send(1, uplinkPacket, uplinkLen);
+    uplinkLen = 0;
+  }
+}
+
+void checkUplink()
+{
+  while (Serial.available()) {
+    uplinkPacket[uplinkLen++] = Serial.read();
+    uplinkLastByte = millis();
+    if (uplinkLen == sizeof(uplinkPacket)) {
+      flushUplink();
+    }
+  }
+
+  if (uplinkLen && millis() - uplinkLastByte >= UPLINK_IDLE) {
+    flushUplink();
+  }
+}
+
+// Give the driver a little while to take enough data that dsize more bytes fit
+void makeBufferRoom(uint8_t dsize)
+{
+  unsigned long end = millis() + SERIAL_ROOM_WAIT;
+  while (SERIAL_BUFFER_SIZE - serialBuffer.count() < dsize && millis() < end) {
+    forwardBufferData();
+  }
 }
 
 void addBufferData(volatile uint8_t *d, uint8_t dsize)
@@ -156,6 +222,45 @@ void addBufferString(const char *s)
   addBufferData((volatile uint8_t *)s, strlen(s));
 }
 
+void receiveSequencedPacket()
+{
+  uint8_t seq = radio.DATA[1];
+  // (A repeated sync packet, whose ACK we lost, is just a repeat)
+  if (radio.DATA[0] == SEQ_SYNC && !(rxSynced && seq == (uint8_t)(rxExpectedSeq - 1))) {
+    rxExpectedSeq = seq;
+    rxSynced = true;
+  }
+  if (!rxSynced) {
+    // We've been reset since the gateway synced; have it sync again
+    uint8_t nak[SEQ_HEADER] = { SEQ_SYNC, seq };
+    radio.sendACK(nak, sizeof(nak));
+    return;
+  }
+
+  int8_t ahead = seq - rxExpectedSeq;
+  if (ahead > 0)
+    return; // something before it went missing; wait for that to be resent
+
+  if (ahead == 0) {
+    uint8_t dsize = radio.DATALEN - SEQ_HEADER;
+    makeBufferRoom(dsize);
+    if (SERIAL_BUFFER_SIZE - serialBuffer.count() < dsize)
+      return; // no ACK, so the gateway sends it again later
+    addBufferData(&radio.DATA[SEQ_HEADER], dsize);
+    rxExpectedSeq++;
+  }
+
+  // New, or a repeat because the gateway missed our ACK: ACK it either way
+  uint8_t ack[SEQ_HEADER] = { SEQ_MARK, seq };
+  radio.sendACK(ack, sizeof(ack));
+}
+
+// The ISP pins are fixed, so the programmer can drive them through the ports directly
+Programmer *newProgrammer()
+{
+  return new Programmer(PIN_RST, new FastBitBangedSPI<PIN_SCK, PIN_MOSI, PIN_MISO>());
+}
+
 void handleFuseRequest(Programmer *programmer, bool isHighFuseRequest)
 {
   if (isHighFuseRequest) {
@@ -244,12 +349,12 @@ void CheckForMagicPackets()
       nextUpdate = millis();
       radio.DATALEN = 0; // Consume the radio data
     } else if (radio.DATALEN == 7 && radio.DATA[3] == 'F' && radio.DATA[4] == 'u' && radio.DATA[5] == 's') {
-      Programmer *programmer = new Programmer(PIN_RST, PIN_MOSI, PIN_MISO, PIN_SCK);
+      Programmer *programmer = newProgrammer();
       handleFuseRequest(programmer, radio.DATA[6] == '+'); // + for high fuses, - for low fuses
       delete programmer;
       radio.DATALEN = 0; // Consume the radio data
     } else if (radio.DATALEN == 8 && radio.DATA[3] == 'F' && radio.DATA[4] == 'u' && radio.DATA[5] == 'S' && radio.DATA[6] == '+') {
-      Programmer *programmer = new Programmer( PIN_RST, PIN_MOSI, PIN_MISO, PIN_SCK);
+      Programmer *programmer = newProgrammer();
       programmer->setHighFuse(radio.DATA[7]);
       sprintf(oneLine, "0x%.2X", programmer->getHighFuse());
       delete programmer;
@@ -257,16 +362,44 @@ void CheckForMagicPackets()
 
       radio.DATALEN = 0; // Consume the radio data
     } else if (radio.DATALEN == 7 && !strcmp((char *)&radio.DATA[3], "Erse")) {
-      Programmer *programmer = new Programmer( PIN_RST, PIN_MOSI, PIN_MISO, PIN_SCK);
-      programmer->eraseTarget();
-      sprintf(oneLine, "Erased");
+      Programmer *programmer = newProgrammer();
+      sprintf(oneLine, programmer->eraseTarget() ? "Erased" : "Erse FAIL");
       delete programmer;
       radio.sendACK(oneLine, strlen(oneLine));
       
+      radio.DATALEN = 0;
+    } else if (radio.DATALEN == 7 && !strcmp((char *)&radio.DATA[3], "Stat")) {
+      // Report how the serial buffer to the driver is coping
+      sprintf(oneLine, "Buf %u/%u, %u dropped", serialBufferHighWater, SERIAL_BUFFER_SIZE, serialBufferDrops);
+      radio.sendACK(oneLine, strlen(oneLine));
+
       radio.DATALEN = 0;
     } else if (radio.DATALEN == 7 && !strcmp((char *)&radio.DATA[3], "Flsh")) {
       enterFlashMode();
       radio.DATALEN = 0; // Consume the radio data
+    } else if (radio.DATALEN == 11 && !memcmp((char *)&radio.DATA[3], "StgB", 4)) {
+      // Begin (or resume) staging an image: length and CRC, big-endian
+      beginStage((radio.DATA[7] << 8) | radio.DATA[8], (radio.DATA[9] << 8) | radio.DATA[10]);
+      radio.DATALEN = 0;
+    } else if (radio.DATALEN > 9 && !memcmp((char *)&radio.DATA[3], "StgD", 4)) {
+      // Image data: offset, big-endian, then the bytes
+      stageData((radio.DATA[7] << 8) | radio.DATA[8], &radio.DATA[9], radio.DATALEN - 9);
+      radio.DATALEN = 0;
+    } else if (radio.DATALEN == 7 && !strcmp((char *)&radio.DATA[3], "StgF")) {
+      enterStagedFlashMode();
+      radio.DATALEN = 0;
+    } else if (radio.DATALEN == 8 && !memcmp((char *)&radio.DATA[3], "PgH", 3)) {
+      // Hash (and keep a copy of) target pages: first page, how many
+      hashPages(radio.DATA[6], radio.DATA[7]);
+      radio.DATALEN = 0;
+    } else if (radio.DATALEN == 11 && !memcmp((char *)&radio.DATA[3], "DltB", 4)) {
+      // Begin a delta update: length and CRC of the whole new image
+      beginDelta((radio.DATA[7] << 8) | radio.DATA[8], (radio.DATA[9] << 8) | radio.DATA[10]);
+      radio.DATALEN = 0;
+    } else if (radio.DATALEN > 9 && !memcmp((char *)&radio.DATA[3], "DltD", 4)) {
+      // Changed page data: offset, big-endian, then the bytes
+      deltaData((radio.DATA[7] << 8) | radio.DATA[8], &radio.DATA[9], radio.DATALEN - 9);
+      radio.DATALEN = 0;
     }
   }
 }
@@ -332,51 +465,48 @@ void loop()
   }
   
   if (radio.receiveDone()) {
-    // Check for ACK request & reply if so
+    if (radio.DATALEN >= SEQ_HEADER && isSequenced(radio.DATA[0])) {
+      // Pipelined from the gateway; handled (and ACKed) in order
+      receiveSequencedPacket();
+    } else {
+      // Check for ACK request & reply if so
     
-    // Look for firmware updates via radio
-    if (radio.DATALEN >= 4 && radio.DATA[0]=='F' && radio.DATA[1]=='L' && radio.DATA[2]=='X' && radio.DATA[3]=='?') {
-      // going to enter programming mode inside CheckForWirelessHex; put the display in text mode to see debug output on serial
-      clearTextMode();
-      addBufferByte('t');
-
-      // flush the buffered serial data, ignoring CTS
-      while (serialBuffer.hasData()) {
-        Serial.write(serialBuffer.consumeByte());
-      }
+      // Look for firmware updates via radio
+      if (radio.DATALEN >= 4 && radio.DATA[0]=='F' && radio.DATA[1]=='L' && radio.DATA[2]=='X' && radio.DATA[3]=='?') {
+        // going to enter programming mode inside CheckForWirelessHex; put the display in text mode to see debug output on serial
+        clearTextMode();
+        addBufferByte('t');
+
+        // flush the buffered serial data, ignoring CTS
+        while (serialBuffer.hasData()) {
+          Serial.write(serialBuffer.consumeByte());
+        }
       
-      // and fire the fan up to max, since we'll be doing other work for a while
-      analogWrite(PIN_FAN, 255);
-    }
-    CheckForWirelessHEX(radio, flash, 1, 9); // checks for the header 'FLX?', debug level 1, but use led on pin 9
+        // and fire the fan up to max, since we'll be doing other work for a while
+        analogWrite(PIN_FAN, 255);
+      }
+      CheckForWirelessHEX(radio, flash, 1, 9); // checks for the header 'FLX?', debug level 1, but use led on pin 9
 
-    CheckForMagicPackets();
+      CheckForMagicPackets();
 
-    // If we have data, dump it in to the serial buffer for sending...
-    if (radio.DATALEN) {
-      addBufferData(radio.DATA, radio.DATALEN);
-    }
+      // If we have data, dump it in to the serial buffer for sending...
+      if (radio.DATALEN) {
+        makeBufferRoom(radio.DATALEN);
+        addBufferData(radio.DATA, radio.DATALEN);
+      }
 
-    // If we send the ACK sooner, we break CheckForWirelessHEX(). Not exactly sure why - dig in to the code and find out. :/
-    if (radio.ACKRequested()) {
-      radio.sendACK();
+      // If we send the ACK sooner, we break CheckForWirelessHEX(). Not exactly sure why - dig in to the code and find out. :/
+      if (radio.ACKRequested()) {
+        radio.sendACK();
+      }
     }
   }
 
-  // If there's serial data waiting to send, and the remote end asserts CTS, then send a character and remove it from the buffer
-  if (serialBuffer.hasData() 
-#ifdef CTSPIN
-  && digitalRead(CTSPIN)
-#endif
-  ) {
-    Serial.write(serialBuffer.consumeByte());
-  }
+  // If there's serial data waiting to send, and the remote end asserts CTS, then send what we can
+  forwardBufferData();
 
-  // If the remote end has sent us data, let's send it to the gateway. One byte at a time right now.
-  if (Serial.available()) {
-    oneLine[0] = Serial.read();
-    radio.send(1, oneLine, 1);
-  }
+  // If the remote end has sent us data, pass it on to the gateway
+  checkUplink();
 
   // Update the fan speed based on temperature
   checkTemperature();
@@ -415,8 +545,7 @@ void fanDance(uint8_t times, uint16_t delayTime)
 
 void enterFlashMode()
 {
-  Programmer *programmer = new Programmer( PIN_RST, PIN_MOSI, PIN_MISO, PIN_SCK);
-  uint8_t oldHighFuse;
+  Programmer *programmer = newProgrammer();
 
   fanDance(2, 150);
   
@@ -436,6 +565,16 @@ void enterFlashMode()
     ps = receiveLineFromRadioAndFlash(programmer);
   } while (ps == PS_OK);
 
+  finishFlashMode(programmer, ps);
+}
+
+// Everything after the image has gone in to the target (or failed to)
+void finishFlashMode(Programmer *programmer, ProgrammerStatus ps)
+{
+  uint8_t oldHighFuse;
+  uint16_t crc;
+  bool verified = false;
+
   if (ps != PS_FlashComplete) {
     // Any other value is an error
     addBufferData((uint8_t*)"\0\0tF1", 5); // try to display it if we can...
@@ -444,6 +583,8 @@ void enterFlashMode()
 	fanDance(5, 500);
       } else if (ps == PS_InvalidPacket) {
       	fanDance(2, 1000);
+      } else if (ps == PS_WriteFailed) {
+      	fanDance(3, 250);
       }
 
     goto error;
@@ -460,14 +601,23 @@ void enterFlashMode()
   oldHighFuse = programmer->getHighFuse();
   if (!(oldHighFuse & 0x01)) {
     // Make sure the bootloader is disabled
-    programmer->setHighFuse(oldHighFuse | 0x01);
+    if (!programmer->setHighFuse(oldHighFuse | 0x01))
+      goto error;
   }
 
+  // Read back what we wrote, so the remote end can check it against what it sent
+  verified = programmer->readBackCrc(&crc);
+
  error:
   delete programmer;
 
-  // Send to the remote end that we're leaving flash mode.
-  sprintf(oneLine, "Flsh..");
+  // Send to the remote end that we're leaving flash mode, with the CRC
+  // of what's now in the target's flash
+  if (verified) {
+    sprintf(oneLine, "Flsh..%.4X", crc);
+  } else {
+    sprintf(oneLine, "Flsh..FAIL");
+  }
   radio.send(1, oneLine, strlen(oneLine));
   
   // Set the fan back to 0 for half a second to signal that we're finished, and then back to full in case there's a problem resuming normal temperature sensing
@@ -477,3 +627,207 @@ void enterFlashMode()
   ResetProMini();
 }
 
+void sendStageOffset()
+{
+  sprintf(oneLine, "Stg %u", stageOffset);
+  radio.sendACK(oneLine, strlen(oneLine));
+}
+
+void beginStage(uint16_t length, uint16_t crc)
+{
+  if (length > STAGE_MAX || (length & 1)) {
+    // Too big for the target, or not whole words
+    stageLength = stageOffset = 0;
+    radio.sendACK("Stg BAD", 7);
+    return;
+  }
+
+  // The same image again picks up where it left off
+  if (stageDelta || length != stageLength || crc != stageCrc) {
+    stageDelta = false;
+    stageLength = length;
+    stageCrc = crc;
+    stageOffset = 0;
+    stageErasedTo = 0;
+  }
+  sendStageOffset();
+}
+
+void stageData(uint16_t offset, volatile uint8_t *d, uint8_t len)
+{
+  // Anything but the next bytes we need (a repeat whose ACK was lost, or
+  // something past a gap) just gets told where we are
+  if (offset == stageOffset && offset + len <= stageLength) {
+    while (offset + len > stageErasedTo) {
+      flash.blockErase4K(STAGE_ADDR + (uint32_t)stageErasedTo);
+      stageErasedTo += STAGE_SECTOR;
+    }
+    flash.writeBytes(STAGE_ADDR + (uint32_t)offset, (const void *)d, len);
+    stageOffset += len;
+  }
+  sendStageOffset();
+}
+
+// Where staged byte off is. The reads that use this are never bigger
+// than a page, and start on a multiple of their size, so they never
+// straddle a page in the staging area and one in the delta area.
+uint32_t stageAddress(uint16_t off)
+{
+  uint16_t page = off / PROGRAMMER_PAGE_BYTES;
+  if (stageDelta && (deltaPages[page / 8] & (1 << (page % 8))))
+    return DELTA_ADDR + (uint32_t)off;
+  return STAGE_ADDR + (uint32_t)off;
+}
+
+void hashPage(uint16_t page, const uint8_t *data)
+{
+  uint32_t addr = STAGE_ADDR + (uint32_t)page * PROGRAMMER_PAGE_BYTES;
+  if (addr % STAGE_SECTOR == 0)
+    flash.blockErase4K(addr);
+  flash.writeBytes(addr, data, PROGRAMMER_PAGE_BYTES);
+
+  uint32_t hash = Programmer::pageHash(data);
+  hashReply[hashReplyLen++] = hash >> 24;
+  hashReply[hashReplyLen++] = hash >> 16;
+  hashReply[hashReplyLen++] = hash >> 8;
+  hashReply[hashReplyLen++] = hash & 0xFF;
+}
+
+/* The first half of a delta update: ACK with the hash (see
+ * Programmer::pageHash()) of each of count pages from first, so the
+ * host can tell which ones its new image changes, and copy them in to
+ * the staging area for beginDelta(). The host asks for them in order
+ * from page 0; each sector of the copy is erased as its first page
+ * comes along.
+ *
+ * The 328P can't erase less than all of its flash over ISP, so the
+ * pages that haven't changed still have to be rewritten; they just
+ * don't have to come over the radio to do it.
+ */
+void hashPages(uint8_t first, uint8_t count)
+{
+  // Whatever was staged is about to be overwritten
+  stageLength = stageOffset = 0;
+  stageDelta = false;
+
+  hashReplyLen = 0;
+  if (count && count <= HASH_PAGES && first + count <= STAGE_PAGES) {
+    Programmer *programmer = newProgrammer();
+    if (!programmer->readPages(first, count, hashPage))
+      hashReplyLen = 0;
+    delete programmer;
+  }
+
+  if (hashReplyLen)
+    radio.sendACK(hashReply, hashReplyLen);
+  else
+    radio.sendACK("PgH BAD", 7); // never a whole number of hashes
+}
+
+void beginDelta(uint16_t length, uint16_t crc)
+{
+  if (length > STAGE_MAX || (length & 1)) {
+    stageLength = stageOffset = 0;
+    stageDelta = false;
+    radio.sendACK("Dlt BAD", 7);
+    return;
+  }
+
+  // Whatever doesn't come in DltD packets is the copy hashPages() left;
+  // if the host got that wrong, enterStagedFlashMode()'s CRC check says so
+  stageLength = stageOffset = length;
+  stageCrc = crc;
+  stageDelta = true;
+  memset(deltaPages, 0, sizeof(deltaPages));
+  deltaErased = 0;
+  radio.sendACK("Dlt OK", 6);
+}
+
+void deltaData(uint16_t offset, volatile uint8_t *d, uint8_t len)
+{
+  uint16_t page = offset / PROGRAMMER_PAGE_BYTES;
+  if (!stageDelta || offset + len > stageLength || (offset + len - 1) / PROGRAMMER_PAGE_BYTES != page) {
+    // Not in this image, or across a page
+    radio.sendACK("Dlt BAD", 7);
+    return;
+  }
+
+  uint8_t sector = offset / STAGE_SECTOR;
+  if (!(deltaErased & (1 << sector))) {
+    flash.blockErase4K(DELTA_ADDR + (uint32_t)sector * STAGE_SECTOR);
+    deltaErased |= 1 << sector;
+  }
+  // A repeat (its ACK was lost) writes the same bytes again, which is harmless
+  flash.writeBytes(DELTA_ADDR + (uint32_t)offset, (const void *)d, len);
+  deltaPages[page / 8] |= 1 << (page % 8);
+  radio.sendACK("Dlt OK", 6);
+}
+
+// CRC-16/CCITT (as _crc_ccitt_update(), from 0xFFFF) of what's staged
+uint16_t stagedCrc()
+{
+  uint16_t crc = 0xFFFF;
+  uint8_t buf[32];
+
+  for (uint16_t off = 0; off < stageLength; off += sizeof(buf)) {
+    uint8_t n = min(sizeof(buf), stageLength - off);
+    flash.readBytes(stageAddress(off), buf, n);
+    for (uint8_t i = 0; i < n; i++) {
+      crc = _crc_ccitt_update(crc, buf[i]);
+    }
+  }
+  return crc;
+}
+
+// Burn the staged image in to the target, as records like the radio's
+// (see Programmer::parseAndStoreDataFromRadio()) read from SPIFlash
+ProgrammerStatus flashFromStage(Programmer *programmer)
+{
+  uint8_t record[4 + STAGE_RECORD];
+  ProgrammerStatus ps = PS_OK;
+
+  for (uint16_t off = 0; off < stageLength && ps == PS_OK; off += STAGE_RECORD) {
+    uint8_t n = min(STAGE_RECORD, stageLength - off);
+    record[0] = 3 + n;      // length of the rest
+    record[1] = off >> 8;   // address
+    record[2] = off & 0xFF;
+    record[3] = 0;          // data
+    flash.readBytes(stageAddress(off), &record[4], n);
+    ps = programmer->parseAndStoreDataFromRadio(4 + n, record);
+  }
+
+  if (ps == PS_OK) {
+    uint8_t eof[4] = { 3, 0, 0, 1 };
+    ps = programmer->parseAndStoreDataFromRadio(sizeof(eof), eof);
+  }
+  return ps;
+}
+
+/* Store-then-flash: the image has already come over the radio in to
+ * SPIFlash (StgB/StgD packets, or for a delta update just the changed
+ * pages, with PgH/DltB/DltD), so the driver is only erased and held in
+ * reset while we burn it from there, at full ISP speed. Nothing is
+ * touched unless all of it arrived and its CRC matches what the host
+ * said it would be.
+ */
+void enterStagedFlashMode()
+{
+  uint16_t crc = stagedCrc();
+  if (!stageLength || stageOffset != stageLength || crc != stageCrc) {
+    sprintf(oneLine, "Stg BAD %u/%u %.4X", stageOffset, stageLength, crc);
+    radio.sendACK(oneLine, strlen(oneLine));
+    return;
+  }
+
+  Programmer *programmer = newProgrammer();
+
+  fanDance(2, 150);
+  analogWrite(PIN_FAN, 255);
+
+  sprintf(oneLine, "Flsh!!");
+  radio.sendACK(oneLine, strlen(oneLine));
+
+  Serial.write("\0\0tPgm", 6); // Can't buffer this: we don't expect to run the main loop for a while
+
+  finishFlashMode(programmer, flashFromStage(programmer));
+}
@@ -47,13 +47,18 @@ sub new {
 	%opts,
 
 	textmode => 0,
+	framing => 0,
 	};
 
     if ($opts->{delay}) {
 	sleep($opts->{delay});
     }
 
-    return bless $opts, $me;
+    my $this = bless $opts, $me;
+    $this->binaryFraming()
+	if ($opts->{binary});
+
+    return $this;
 }
 
 sub init {
@@ -118,6 +123,9 @@ sub sendCommand {
 
     $l ||= length($cmd);
 
+    return $this->sendFramedCommand(substr($cmd, 0, $l))
+	if ($this->{framing});
+
     my $destNode = $this->{destNode};
 #    print("sending command: '$cmd' l '$l' ");
     print("sending to dest $destNode length " . $l . "\n");
@@ -157,6 +165,272 @@ sub sendCommand {
     return 1;
 }
 
+# Binary framing with the gateway (see gateway.ino): no per-byte echo,
+# and a CRC-checked result for every packet. Pass binary => 1 to new(),
+# or call binaryFraming(); textFraming() goes back (e.g. before
+# 'TO:' programming).
+
+use constant SOF => 0xA5;
+use constant GATEWAY_NODE => 0;
+
+# CRC-16/CCITT as avr-libc's _crc_ccitt_update() does it, from 0xFFFF
+sub crc16 {
+    my ($data) = @_;
+
+    my $crc = 0xFFFF;
+    foreach my $c (unpack('C*', $data)) {
+	$crc ^= $c;
+	for (1..8) {
+	    $crc = ($crc & 1) ? (($crc >> 1) ^ 0x8408) : ($crc >> 1);
+	}
+    }
+    return $crc;
+}
+
+sub binaryFraming {
+    my ($this) = @_;
+
+    local $this->{destNode} = GATEWAY_NODE;
+    defined($this->sendCommand('B'))
+	or die "Gateway didn't switch to binary framing";
+    $this->{framing} = 1;
+    $this->{frameId} = 0;
+    $this->{pending} = {};
+    $this->{order} = [];
+    $this->{goBack} = undef;
+    $this->{uplink} = '';
+}
+
+sub textFraming {
+    my ($this) = @_;
+
+    local $this->{destNode} = GATEWAY_NODE;
+    $this->sendCommand('T');
+    $this->{framing} = 0;
+}
+
+# Exactly $n bytes, or undef if they don't arrive within $timeout seconds
+sub readBytes {
+    my ($this, $n, $timeout) = @_;
+
+    my $buf = '';
+    my $end = time() + $timeout;
+    while (length($buf) < $n) {
+	my ($count, $r) = $this->{port}->read($n - length($buf));
+	$buf .= $r
+	    if ($count);
+	return undef
+	    if (length($buf) < $n && time() > $end);
+    }
+    return $buf;
+}
+
+# The next good frame from the gateway as (type, id, data), or () on timeout
+sub readFrame {
+    my ($this, $timeout) = @_;
+
+    while (1) {
+	my $c = $this->readBytes(1, $timeout);
+	return () unless defined($c);
+	next unless (ord($c) == SOF);
+
+	my $header = $this->readBytes(3, $timeout);
+	return () unless defined($header);
+	my ($type, $id, $len) = unpack('CCC', $header);
+
+	my $rest = $this->readBytes($len + 2, $timeout);
+	return () unless defined($rest);
+	my $data = substr($rest, 0, $len);
+
+	# A damaged frame is dropped; the sender times out and retries
+	next unless (unpack('n', substr($rest, $len)) == crc16($header . $data));
+	return (chr($type), $id, $data);
+    }
+}
+
+# Frames the gateway hasn't answered yet, by id, and their ids in the
+# order we sent them. It keeps up to TX_WINDOW packets in flight to the
+# display (see gateway.ino); we keep no more than that outstanding, so
+# none of them has to wait in its serial buffer.
+use constant TX_WINDOW => 4;
+use constant FRAME_TRIES => 3;
+
+sub writeFrame {
+    my ($this, $destNode, $data) = @_;
+
+    my $id = $this->{frameId} = ($this->{frameId} % 255) + 1;
+    $this->{pending}->{$id} = { destNode => $destNode,
+				data => $data,
+				tries => 0 };
+    push(@{$this->{order}}, $id);
+    $this->transmitFrame($id);
+    return $id;
+}
+
+# (Re)send a pending frame, with the id it was first given
+sub transmitFrame {
+    my ($this, $id) = @_;
+
+    my $p = $this->{pending}->{$id};
+    my $body = pack('CCC', $p->{destNode}, $id, length($p->{data})) . $p->{data};
+    $this->{port}->write(chr(SOF) . $body . pack('n', crc16($body)));
+    $p->{tries}++;
+}
+
+# The gateway takes frames strictly in order, so when one is lost we go
+# back to it and send it and everything after it again. Returns false
+# if one of them has been tried too often.
+sub resendFrom {
+    my ($this, $id) = @_;
+
+    my @order = @{$this->{order}};
+    shift(@order) while (@order && $order[0] != $id);
+    foreach my $i (@order) {
+	return 0
+	    if ($this->{pending}->{$i}->{tries} >= FRAME_TRIES);
+    }
+
+    $this->{goBack} = undef;
+    $this->transmitFrame($_) foreach (@order);
+    return 1;
+}
+
+# Where a pending frame is in the order we sent them, or undef
+sub orderOf {
+    my ($this, $id) = @_;
+
+    for (my $i = 0; $i < @{$this->{order}}; $i++) {
+	return $i
+	    if ($this->{order}->[$i] == $id);
+    }
+    return undef;
+}
+
+sub donePending {
+    my ($this, $id) = @_;
+
+    delete $this->{pending}->{$id};
+    $this->{order} = [ grep { $_ != $id } @{$this->{order}} ];
+}
+
+# Wait for the gateway to finish with one of the pending frames, and
+# return its (id, ACK data); or () if it can't be got through.
+sub reapFrame {
+    my ($this) = @_;
+
+    while (@{$this->{order}}) {
+	my ($type, $fid, $fdata) = $this->readFrame(5);
+	unless (defined($type)) {
+	    # Gone quiet: the oldest frame never got there (its CRC
+	    # failed), or it did and its answer didn't get back; or the
+	    # last one we sent was lost too, so we never heard it refused
+	    my $from = defined($this->{goBack}) ? $this->{goBack} : $this->{order}->[0];
+	    return ()
+		unless ($this->resendFrom($from));
+	    next;
+	}
+	if ($type eq 'U') {
+	    # Something the display sent us; keep it for opportunisticResponse
+	    $this->{uplink} .= $fdata;
+	    next;
+	}
+	my $p = $this->{pending}->{$fid};
+	next unless $p;
+
+	if ($type eq 'E') {
+	    # Refused because it came after one the gateway didn't get.
+	    # It refuses everything after that too, so we go back once the
+	    # last frame we sent has been refused (and so none of these
+	    # answers are still to come, to be taken for ones to the
+	    # frames we send again).
+	    my $want = ord($fdata);
+	    my $wantAt = $this->orderOf($want);
+	    if (defined($wantAt)) {
+		# If it wants one after this, this was a repeat of one it
+		# already has, and the answer to that is still to come
+		next
+		    if ($wantAt > $this->orderOf($fid));
+		$this->{goBack} = $want;
+		next
+		    unless ($fid == $this->{order}->[-1]);
+		return ()
+		    unless ($this->resendFrom($want));
+		next;
+	    }
+	    # It wants one we haven't sent, so it took this one the first
+	    # time; the answer to that was lost
+	    $this->donePending($fid);
+	    return ($fid, undef);
+	}
+	$this->donePending($fid);
+	die "NAK"
+	    if ($type eq 'N');
+	return ($fid, $fdata);
+    }
+    return ();
+}
+
+# Wait for everything pending
+sub flush {
+    my ($this) = @_;
+
+    while (@{$this->{order}}) {
+	my ($id) = $this->reapFrame();
+	unless (defined($id)) {
+	    $this->abandonPending();
+	    return undef;
+	}
+    }
+    return 1;
+}
+
+# Give up on everything pending. The gateway is still waiting for the
+# first of them, so start its numbering over.
+sub abandonPending {
+    my ($this) = @_;
+
+    print("failed to ACK\n");
+    $this->{pending} = {};
+    $this->{order} = [];
+    return
+	if ($this->{restarting}); # it was the restart that failed
+    local $this->{restarting} = 1;
+    $this->binaryFraming();
+}
+
+# sendCommand(), over binary framing
+sub sendFramedCommand {
+    my ($this, $cmd) = @_;
+
+    $this->flush();
+    $this->writeFrame($this->{destNode}, $cmd);
+    my ($id, $ack) = $this->reapFrame();
+    unless (defined($id)) {
+	$this->abandonPending();
+	return undef;
+    }
+    return $ack;
+}
+
+# Like sendCommand(), but with binary framing it doesn't wait for the
+# ACK; call flush() (or any sendCommand()) to wait for them all. Use it
+# for streams of commands where only a failure matters.
+sub queueCommand {
+    my ($this, $cmd, $l) = @_;
+
+    return $this->sendCommand($cmd, $l)
+	unless ($this->{framing});
+
+    $l ||= length($cmd);
+    while (keys(%{$this->{pending}}) >= TX_WINDOW) {
+	my ($id) = $this->reapFrame();
+	die "failed to ACK"
+	    unless (defined($id));
+    }
+    $this->writeFrame($this->{destNode}, substr($cmd, 0, $l));
+    return 1;
+}
+
 sub blockForChar {
     my ($this) = @_;
 
@@ -183,6 +457,16 @@ sub getResponse {
 
 sub opportunisticResponse {
     my ($this) = @_;
+
+    if ($this->{framing}) {
+	my ($type, $id, $data) = $this->readFrame(1);
+	$this->{uplink} .= $data
+	    if (defined($type) && $type eq 'U');
+	my $r = $this->{uplink};
+	$this->{uplink} = '';
+	return (length($r), length($r) ? $r : undef);
+    }
+
     my ($count, $r) = $this->{port}->read(1024);
     return ($count, $r);
 }
@@ -222,6 +506,176 @@ sub brightness {
     $this->sendCommand("b" . chr($b));
 }
 
+# Brightness as a scale, 0 (dark) to 255 (full), applied to each frame
+# as it's sent to the LEDs
+sub brightnessScale {
+    my ($this, $b) = @_;
+
+    $this->endTextMode();
+    $this->sendCommand("B" . chr($b));
+}
+
+# Gamma-correct each frame as it's sent to the LEDs (true/false)
+sub gamma {
+    my ($this, $on) = @_;
+
+    $this->endTextMode();
+    $this->sendCommand("G" . chr($on ? 1 : 0));
+}
+
+# Palette-indexed frames, for host-driven animation in raw mode.
+# palette() sets up to 16 colors (each an [r, g, b] array ref); frame()
+# sends a whole display of palette indexes (an array ref, pixel 0 first),
+# run-length encoded; deltaFrame() sends just the pixels that differ from
+# the last frame sent. Frames too big for one command go as several, and
+# the display isn't updated until the last of them arrives.
+
+use constant TOTAL_LEDS => 192;
+use constant MAX_VARLEN => 48; # most bytes after a 'P'/'F'/'D' length byte
+use constant FRAME_MORE => 1;
+use constant FRAME_FIRST => 2;
+
+sub palette {
+    my ($this, @colors) = @_;
+
+    die "At most 16 palette entries"
+	if (@colors > 16);
+
+    my $entries = chr(0); # starting at index 0
+    foreach my $c (@colors) {
+	my ($r, $g, $b) = @$c;
+	$entries .= pack('n', (($r & 0xF8) << 8) | (($g & 0xFC) << 3) | ($b >> 3));
+    }
+
+    $this->endTextMode();
+    $this->sendCommand('P' . chr(length($entries)) . $entries);
+}
+
+# One run byte for the pixels starting at $p: up to 16 of the same index
+sub runAt {
+    my ($pixels, $p) = @_;
+
+    my $n = 1;
+    $n++ while ($p + $n < @$pixels && $n < 16 &&
+		$pixels->[$p + $n] == $pixels->[$p]);
+    return ($n, chr((($n - 1) << 4) | ($pixels->[$p] & 0x0F)));
+}
+
+sub encodeFrame {
+    my ($pixels) = @_;
+
+    my @units;
+    my $p = 0;
+    while ($p < @$pixels) {
+	my ($n, $run) = runAt($pixels, $p);
+	push(@units, $run);
+	$p += $n;
+    }
+    return @units;
+}
+
+# (pixels to skip, run byte) pairs for the pixels that changed
+sub encodeDelta {
+    my ($old, $new) = @_;
+
+    my @units;
+    my ($p, $skip) = (0, 0);
+    while ($p < @$new) {
+	if ($new->[$p] == $old->[$p]) {
+	    $skip++;
+	    $p++;
+	    next;
+	}
+	my ($n, $run) = runAt($new, $p);
+	push(@units, chr($skip) . $run);
+	$skip = 0;
+	$p += $n;
+    }
+    return @units;
+}
+
+# Pack whole units in to as few commands as will hold them
+sub sendFrameChunks {
+    my ($this, $trigger, @units) = @_;
+
+    my @chunks = ('');
+    foreach my $u (@units) {
+	push(@chunks, '')
+	    if (length($chunks[-1]) + length($u) > MAX_VARLEN - 1); # -1 for flags
+	$chunks[-1] .= $u;
+    }
+
+    for (my $i = 0; $i < @chunks; $i++) {
+	my $flags = ($i ? 0 : FRAME_FIRST) | ($i < $#chunks ? FRAME_MORE : 0);
+	my $payload = chr($flags) . $chunks[$i];
+	$this->queueCommand($trigger . chr(length($payload)) . $payload);
+    }
+}
+
+sub frame {
+    my ($this, $pixels) = @_;
+
+    die "A frame is " . TOTAL_LEDS . " pixels"
+	unless (@$pixels == TOTAL_LEDS);
+
+    $this->endTextMode();
+    $this->sendFrameChunks('F', encodeFrame($pixels));
+    $this->{lastFrame} = [ @$pixels ];
+}
+
+sub deltaFrame {
+    my ($this, $pixels) = @_;
+
+    return $this->frame($pixels)
+	unless ($this->{lastFrame} && @$pixels == TOTAL_LEDS);
+
+    my @delta = encodeDelta($this->{lastFrame}, $pixels);
+    return unless @delta; # nothing changed
+
+    # If most of the display changed, the whole frame may be smaller
+    return $this->frame($pixels)
+	if (length(join('', @delta)) >= length(join('', encodeFrame($pixels))));
+
+    $this->endTextMode();
+    $this->sendFrameChunks('D', @delta);
+    $this->{lastFrame} = [ @$pixels ];
+}
+
+# Animations stored on the display and played back there, so they only
+# cross the radio once. storeFrame() saves what's on the display now as
+# frame $n, shown for $delay mS; animate() loops through frames
+# 0 .. $count-1. uploadAnimation() does the lot from a list of frames of
+# palette indexes (see frame()), all shown for $delay mS.
+
+sub storeFrame {
+    my ($this, $n, $delay) = @_;
+
+    $this->endTextMode();
+    $this->queueCommand('S' . chr($n) . pack('n', $delay));
+}
+
+sub animate {
+    my ($this, $count) = @_;
+
+    $this->endTextMode();
+    $this->sendCommand('A' . chr($count));
+}
+
+sub uploadAnimation {
+    my ($this, $delay, @frames) = @_;
+
+    die "At most 225 frames"
+	if (@frames > 225);
+
+    $this->raw(); # ... which also turns off fading, so we store what we sent
+    delete $this->{lastFrame};
+    for (my $i = 0; $i < @frames; $i++) {
+	$this->deltaFrame($frames[$i]);
+	$this->storeFrame($i, $delay);
+    }
+    $this->animate(scalar(@frames));
+}
+
 sub chase {
     my ($this, $repeat, $r, $g, $b) = @_;
 
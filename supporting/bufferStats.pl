@@ -0,0 +1,15 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use Display;
+use Time::HiRes qw/sleep/;
+
+my $destNode = 3;
+
+my $d = Display->new( destNode => $destNode );
+print("starting up\n");
+
+# The receiver's serial buffer to the driver: high-water mark and bytes dropped
+my $resp = $d->sendCommand('~~~Stat');
+print "$resp\n";
@@ -5,75 +5,222 @@ use warnings;
 use Display;
 use Time::HiRes qw/sleep/;
 
+# By default the image is staged in the receiver's SPIFlash, checked, and
+# only then burned in to the Pro Mini. --live programs it line by line
+# as it arrives, as this always used to. --delta stages it too, but only
+# sends the flash pages that differ from what the Pro Mini already has.
+my ($live, $delta) = (0, 0);
+while (@ARGV && $ARGV[0] =~ /^--/) {
+    my $opt = shift(@ARGV);
+    if ($opt eq '--live') {
+	$live = 1;
+    } elsif ($opt eq '--delta') {
+	$delta = 1;
+    } else {
+	die "Unknown option $opt";
+    }
+}
 my $file = shift || die "No .hex file path given";
 open(FH, $file) || die "Couldn't open .hex file $file\n";
 
+use constant STAGE_CHUNK => 52; # what fits in a radio packet after '~~~StgD' and the offset
+use constant PAGE_BYTES => 128; # the 328P's flash pages
+use constant HASH_PAGES => 8;   # how many the receiver hashes per '~~~PgH'
+
 my $destNode = 3;
 
+my @records = map { prepData($_) } <FH>;
+my %image; # address => byte, to check the receiver's CRC against
+addToImage($_) foreach (@records);
+
 my $d = Display->new( destNode => $destNode );
 print("starting up\n");
 
-$d->sendCommand("\0\0    ");
-sleep(1);
-my $resp = $d->sendCommand('~~~Flsh');
-die "Remote failed to confirm programming mode"
-    unless ($resp eq 'Flsh!!');
+my ($resp, $expected);
+if ($live) {
+    $d->sendCommand("\0\0    ");
+    sleep(1);
+    $resp = $d->sendCommand('~~~Flsh');
+    die "Remote failed to confirm programming mode"
+	unless ($resp eq 'Flsh!!');
 
-print "Sending flash data\n";
-my $count = 0;
-while (<FH>) {
-#    die "Invalid line; can't be > 61 chars"
-#	if (length($_) > 61);
+    print "Sending flash data\n";
+    my $count = 0;
+    foreach my $orig (@records) {
+	$resp = $d->sendCommand($orig);
+	die "failed to get proper ack"
+	    unless ($resp eq $orig);
 
-    my $orig = prepData($_);
-    $resp = $d->sendCommand($orig);
-    die "failed to get proper ack"
-	unless ($resp eq $orig);
+	print($count, "\n");
 
-    print($count, "\n");
+	$count++;
+    }
+    $expected = Display::crc16(imageBytes());
+} elsif ($delta) {
+    my $bytes = stageBytes();
+    $expected = Display::crc16($bytes);
+    my $pages = int((length($bytes) + PAGE_BYTES - 1) / PAGE_BYTES);
+
+    # The receiver hashes what's on the Pro Mini a few pages at a time
+    # (keeping a copy of it), and we only send the pages that differ
+    print "Reading page hashes\n";
+    my @changed;
+    for (my $first = 0; $first < $pages; $first += HASH_PAGES) {
+	my $count = $pages - $first;
+	$count = HASH_PAGES
+	    if ($count > HASH_PAGES);
+	my $r = retry("hashing page $first", sub { $d->sendCommand('~~~PgH' . pack('CC', $first, $count)) });
+	die "Receiver couldn't read the Pro Mini's flash"
+	    unless (length($r) == 4 * $count);
+
+	my @hashes = unpack('N*', $r);
+	for (my $i = 0; $i < $count; $i++) {
+	    my $page = substr($bytes, ($first + $i) * PAGE_BYTES, PAGE_BYTES);
+	    $page .= "\xFF" x (PAGE_BYTES - length($page)); # erased past the end of the image
+	    push(@changed, $first + $i)
+		unless (pageHash($page) == $hashes[$i]);
+	}
+    }
+    unless (@changed) {
+	print "Nothing has changed\n";
+	exit 0;
+    }
+    print scalar(@changed), " of $pages pages changed\n";
+
+    my $r = $d->sendCommand('~~~DltB' . pack('nn', length($bytes), $expected));
+    die "Receiver can't take this image"
+	unless (defined($r) && $r eq 'Dlt OK');
+
+    print "Staging changed pages\n";
+    foreach my $page (@changed) {
+	my $end = ($page + 1) * PAGE_BYTES;
+	$end = length($bytes)
+	    if ($end > length($bytes));
+	for (my $offset = $page * PAGE_BYTES; $offset < $end; $offset += STAGE_CHUNK) {
+	    my $len = $end - $offset;
+	    $len = STAGE_CHUNK
+		if ($len > STAGE_CHUNK);
+	    $r = retry("page $page", sub { $d->sendCommand('~~~DltD' . pack('n', $offset) . substr($bytes, $offset, $len)) });
+	    die "Receiver refused page $page: $r"
+		unless ($r eq 'Dlt OK');
+	}
+	print "page $page\n";
+    }
+
+    burnStaged();
+} else {
+    my $bytes = stageBytes();
+    $expected = Display::crc16($bytes);
+
+    # If the receiver already has some of this same image, it tells us
+    # how much, and we carry on from there
+    my $offset = stageOffset($d->sendCommand('~~~StgB' . pack('nn', length($bytes), $expected)));
+    print "Resuming at $offset\n"
+	if ($offset);
+
+    print "Staging flash data\n";
+    while ($offset < length($bytes)) {
+	my $r = retry("at $offset", sub { $d->sendCommand('~~~StgD' . pack('n', $offset) . substr($bytes, $offset, STAGE_CHUNK)) });
+	$offset = stageOffset($r);
+	print($offset, "/", length($bytes), "\n");
+    }
 
-    $count++;
+    burnStaged();
 }
+
 print "Waiting for confirmation of end of flash...\n";
-expect('Flsh..');
-print "Success!\n";
+my $crc = expect('Flsh\.\.([0-9A-F]{4}|FAIL)');
+die "Couldn't read the flash back to verify it"
+    if ($crc eq 'FAIL');
+$expected = sprintf("%.4X", $expected);
+die "Verification failed: flash has CRC $crc, .hex file has $expected"
+    unless ($crc eq $expected);
+print "Success! (CRC $crc)\n";
 
 exit 0;
 
-sub prepData {
-    my ($l) = @_;
-
-#    print "$l\n";
-
-    # Turn the line $l (Intel HEX format data) in to a binary blob to send
-    die "invalid data"
-	unless ($l =~ /^:/ && length($_) >= 9);
-    # Data looks like this:
-    # :100000000C9466010C948E010C948E010C948E015C
-    # :100010000C948E010C948E010C948E010C948E0124
-    # Count: 1 byte (2 digits)
-    # address: 2 bytes (4 digits), big-endian
-    # type: 1 byte (2 digits)
-    # ... so the end line of a hex file, which looks like
-    # :00000001FF
-    # ... will pack up as these bytes:
-    #   ( 0x03, 0x00, 0x00, 0x01)
-    # because the checksum is discarded.
-
-    my @data;
-    my $count = hex(substr($l, 1, 2)); # number of bytes of data on this line
-    my $pos = 0;
-    while ($pos < ($count + 3) * 2) { # +3 for the two address bytes and type; *2 for each digit
-	push (@data, hex(substr($l, 3 + $pos, 2))); # Pull the two digits out of the string, read as hex
-	$pos+=2;
+# 32-bit FNV-1a, as Programmer::pageHash(); not the CRC, which has to
+# catch anything this misses
+sub pageHash {
+    my ($page) = @_;
+
+    my $hash = 2166136261;
+    foreach my $c (unpack('C*', $page)) {
+	$hash = (($hash ^ $c) * 16777619) & 0xFFFFFFFF;
     }
+    return $hash;
+}
 
-    # @data now contains the data to send to the remote end. Let's pack it up with a length header
-#    use Data::Dumper;
-#    print Dumper(\@data);
+# Have the receiver burn what it's staged, once it's checked the CRC
+sub burnStaged {
+    $d->sendCommand("\0\0    ");
+    my $resp = $d->sendCommand('~~~StgF');
+    die "Receiver didn't verify the staged image: " . (defined($resp) ? $resp : 'no answer')
+	unless (defined($resp) && $resp eq 'Flsh!!');
+}
+
+# A lost packet (or ACK) just gets sent again, up to 10 times in a row
+sub retry {
+    my ($what, $send) = @_;
+
+    for (my $failures = 0; $failures < 10; $failures++) {
+	my $r = eval { $send->() };
+	return $r
+	    if (defined($r));
+	print "retrying $what\n";
+    }
+    die "Giving up $what; run again to resume";
+}
+
+# The image to stage: from address 0, in whole words
+sub stageBytes {
+    my $bytes = imageBytes(0);
+    $bytes .= "\xFF"
+	if (length($bytes) & 1);
+    return $bytes;
+}
 
-    my $d = pack("C*", scalar @data, @data);
-    return $d;
+# The receiver's answer to a staging packet: how many bytes it has
+sub stageOffset {
+    my ($resp) = @_;
+
+    die "Receiver didn't answer"
+	unless (defined($resp));
+    die "Receiver can't stage this image"
+	if ($resp =~ /^Stg BAD/);
+    die "Unexpected staging reply '$resp'"
+	unless ($resp =~ /^Stg (\d+)$/);
+    return $1;
+}
+
+# Keep track of the bytes a prepData() record puts where
+sub addToImage {
+    my ($rec) = @_;
+
+    my ($len, $address, $type, @data) = unpack('CnCC*', $rec);
+    return unless ($type == 0); # data records only
+    for (my $i = 0; $i < @data; $i++) {
+	$image{$address + $i} = $data[$i];
+    }
+}
+
+# The image as one string of bytes, from $from (or its lowest address)
+# to its highest, with any gaps as the erased 0xFF. The receiver's CRC
+# is of the same range.
+sub imageBytes {
+    my ($from) = @_;
+
+    my @addresses = sort { $a <=> $b } keys(%image);
+    return ''
+	unless @addresses;
+    $from = $addresses[0]
+	unless defined($from);
+
+    my $bytes = '';
+    for my $a ($from .. $addresses[-1]) {
+	$bytes .= chr(defined($image{$a}) ? $image{$a} : 0xFF);
+    }
+    return $bytes;
 }
 
 sub expect {
@@ -91,7 +238,7 @@ sub expect {
 		print "$resp\n"
 		    if ($resp);
 	    }
-	    last
+	    return $1
 		if ($resp =~ /$what/);
 	}
     }